@@ -10,15 +10,19 @@
 #include "addons/waylandserver/WaylandServer_public.h"
 #include "addons/wlfrontend/WLFrontend_public.h"
 #include "dimcore/Dim.h"
+#include "dimcore/EngineCache.h"
 #include "dimcore/Events.h"
 #include "dimcore/InputContext.h"
 #include "dimcore/InputMethodEntry.h"
+#include "dimcore/Tracer.h"
 #include "wl/client/Compositor.h"
 #include "wl/client/ConnectionBase.h"
 #include "wl/client/ConnectionRaw.h"
 #include "wl/client/ZwpInputMethodV2.h"
 
 #include <QGuiApplication>
+#include <QSettings>
+#include <QStandardPaths>
 
 using namespace org::deepin::dim;
 WL_ADDONS_BASE_USE_NAMESPACE
@@ -28,12 +32,21 @@ static const std::string KEYBOARD_PREFIX = "keyboard-";
 
 static const char *SOCKET_NAME = "dim";
 
+// the input method files change when engines are installed or removed
+static uint64_t inputMethodsStamp()
+{
+    return EngineCache::stamp({
+        QStringLiteral("/usr/share/fcitx5/inputmethod"),
+        QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+            + QStringLiteral("/fcitx5/inputmethod"),
+    });
+}
+
 DIM_ADDON_FACTORY(Fcitx5Proxy);
 
 Fcitx5Proxy::Fcitx5Proxy(Dim *dim)
     : ProxyAddon(dim, "fcitx5", "org.fcitx.Fcitx5")
     , focusedId_(0)
-    , fcitx5Proc_(new QProcess(this))
 {
     Addon *wls = dim->addons().at("waylandserver");
     auto wl = waylandserver::getServer(wls);
@@ -48,7 +61,8 @@ Fcitx5Proxy::Fcitx5Proxy(Dim *dim)
                 return;
             }
 
-            ic->forwardKey(event->keycode, event->state);
+            // fcitx5 forwards a key with the time it got the key with
+            ic->forwardKey(event->keycode, event->state, event->time_msec);
         });
     });
 
@@ -90,8 +104,6 @@ Fcitx5Proxy::Fcitx5Proxy(Dim *dim)
             popup_.reset();
         });
     });
-
-    launchDaemon();
 }
 
 void Fcitx5Proxy::initDBusConn()
@@ -112,7 +124,43 @@ void Fcitx5Proxy::initDBusConn()
 
 void Fcitx5Proxy::initInputMethods()
 {
-    updateInputMethods();
+    // The live list replaces it once the daemon is up, see updateInputMethods(). Without a
+    // current cache the daemon is launched to list the input methods, then it's left to the idle
+    // reaper.
+    engineCacheCurrent_ =
+        EngineCache::load(EngineCache::path(key()), inputMethodsStamp(), key(), inputMethods_)
+        == EngineCache::CURRENT;
+    if (!engineCacheCurrent_) {
+        requestDaemon();
+    }
+    Q_EMIT addonInitFinished(this);
+
+    loadProfile();
+}
+
+void Fcitx5Proxy::loadProfile()
+{
+    QSettings profile(QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+                          + QStringLiteral("/fcitx5/profile"),
+                      QSettings::IniFormat);
+
+    std::vector<std::string> activeInputMethods;
+    for (int i = 0;; i++) {
+        const QString item = QStringLiteral("Groups/0/Items/%1/Name").arg(i);
+        if (!profile.contains(item)) {
+            break;
+        }
+
+        auto uniqueName = profile.value(item).toString().toStdString();
+        if (shouldBeIgnored(uniqueName)) {
+            continue;
+        }
+        activeInputMethods.emplace_back(uniqueName);
+    }
+
+    if (!activeInputMethods.empty()) {
+        updateActiveInputMethods(activeInputMethods);
+    }
 }
 
 Fcitx5Proxy::~Fcitx5Proxy() { }
@@ -147,7 +195,13 @@ void Fcitx5Proxy::focusOut(uint32_t id)
     im->sendDeactivate();
 }
 
-void Fcitx5Proxy::destroyed(uint32_t id) { }
+void Fcitx5Proxy::destroyed(uint32_t id)
+{
+    // the id may be handed out again with a new generation, don't keep it around
+    if (focusedId_ == id) {
+        focusedId_ = 0;
+    }
+}
 
 void Fcitx5Proxy::done()
 {
@@ -172,6 +226,7 @@ void Fcitx5Proxy::contentType(uint32_t hint, uint32_t purpose)
 void Fcitx5Proxy::setCurrentIM(const std::string &im)
 {
     if (available_ && dbusProvider_) {
+        DIM_TRACE_SCOPE("fcitx5", "SetCurrentIM");
         dbusProvider_->controller()->SetCurrentIM(QString::fromStdString(im));
     }
 }
@@ -189,11 +244,22 @@ bool Fcitx5Proxy::keyEvent([[maybe_unused]] const InputMethodEntry &entry,
         return false;
     }
 
-    im->sendKey(keyEvent.keycode(), keyEvent.isRelease());
+    keyEvent.setSerial(im->sendKey(keyEvent.keycode(), keyEvent.isRelease()));
 
     return true;
 }
 
+void Fcitx5Proxy::releaseKey(uint32_t id, uint32_t keycode)
+{
+    if (focusedId_ != id) {
+        return;
+    }
+
+    if (auto *im = wl_->inputMethodV2(IMType::FCITX5)) {
+        im->sendKey(keycode, true);
+    }
+}
+
 void Fcitx5Proxy::cursorRectangleChangeEvent(InputContextCursorRectChangeEvent &event)
 {
     auto *im = wl_->inputMethodV2(IMType::FCITX5);
@@ -213,15 +279,15 @@ void Fcitx5Proxy::updateSurroundingText(InputContextEvent &event)
         return;
     }
 
-    im->sendSurroundingText(surroundingText.text().toUtf8().data(),
+    im->sendSurroundingText(surroundingText.text().constData(),
                             surroundingText.cursor(),
                             surroundingText.anchor());
 }
 
 void Fcitx5Proxy::updateInputMethods()
 {
+    // the last list is kept while the daemon is stopped
     if (!available_ || !dbusProvider_) {
-        inputMethods_.clear();
         return;
     }
 
@@ -235,6 +301,7 @@ void Fcitx5Proxy::updateInputMethods()
                 this,
                 [this](QDBusPendingCallWatcher *watcher) {
                     watcher->deleteLater();
+                    DIM_TRACE_SCOPE("fcitx5", "AvailableInputMethods");
 
                     QDBusPendingReply<FcitxQtInputMethodEntryList> reply = *watcher;
 
@@ -254,8 +321,17 @@ void Fcitx5Proxy::updateInputMethods()
                                                              im.icon().toStdString()));
                     }
 
-                    inputMethods_.swap(inputMethods);
-                    Q_EMIT addonInitFinished(this);
+                    // usually the same as the cached list published at startup
+                    if (inputMethods != inputMethods_) {
+                        inputMethods_.swap(inputMethods);
+                        engineCacheCurrent_ = false;
+                        Q_EMIT addonInitFinished(this);
+                    }
+                    if (!engineCacheCurrent_) {
+                        engineCacheCurrent_ = EngineCache::save(EngineCache::path(key()),
+                                                                inputMethodsStamp(),
+                                                                inputMethods_);
+                    }
                 });
     }
 
@@ -273,7 +349,10 @@ void Fcitx5Proxy::updateInputMethods()
                     auto group = groups[0];
 
                     auto groupInfoCall = controller->InputMethodGroupInfo(group);
-                    groupInfoCall.waitForFinished();
+                    {
+                        DIM_TRACE_SCOPE("fcitx5", "InputMethodGroupInfo");
+                        groupInfoCall.waitForFinished();
+                    }
 
                     std::vector<std::string> activeInputMethods;
                     auto ims = groupInfoCall.argumentAt<1>();
@@ -303,6 +382,18 @@ void Fcitx5Proxy::launchDaemon()
         return;
     }
 
+    if (fcitx5Proc_) {
+        stopDaemon();
+    }
+
+    fcitx5Proc_ = new QProcess(this);
+    connect(fcitx5Proc_, &QProcess::started, this, [this] {
+        qDebug() << "launch fcitx5 success" << fcitx5Proc_->processId();
+        if (!dbusProvider_) {
+            initDBusConn();
+        }
+    });
+
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     env.insert("WAYLAND_DISPLAY", SOCKET_NAME);
 
@@ -314,11 +405,18 @@ void Fcitx5Proxy::launchDaemon()
     fcitx5Proc_->setStandardOutputFile("/tmp/fcitx5.log");
     fcitx5Proc_->setStandardErrorFile("/tmp/fcitx5.log");
     fcitx5Proc_->start();
+}
 
-    connect(fcitx5Proc_, &QProcess::started, this, [this] {
-        qDebug() << "launch fcitx5 success" << fcitx5Proc_->processId();
-        initDBusConn();
-    });
+void Fcitx5Proxy::stopDaemon()
+{
+    if (!fcitx5Proc_) {
+        return;
+    }
+
+    disconnect(fcitx5Proc_, nullptr, this, nullptr);
+
+    stopProcess(fcitx5Proc_);
+    fcitx5Proc_ = nullptr;
 }
 
 InputContext *Fcitx5Proxy::getFocusedIC(uint32_t id) const
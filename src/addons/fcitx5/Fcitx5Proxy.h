@@ -40,12 +40,18 @@ public:
     void updateSurroundingText(InputContextEvent &event) override;
     void cursorRectangleChangeEvent(InputContextCursorRectChangeEvent &event) override;
     void setCurrentIM(const std::string &im) override;
+    void releaseKey(uint32_t id, uint32_t keycode) override;
+
+protected:
+    void launchDaemon() override;
+    void stopDaemon() override;
 
 private:
     void updateInputMethods();
     bool shouldBeIgnored(const std::string &uniqueName) const;
     void initDBusConn();
-    void launchDaemon();
+    // the input methods of the first group in the fcitx5 profile, read without the daemon
+    void loadProfile();
     InputContext* getFocusedIC(uint32_t id) const;
 
 private:
@@ -56,7 +62,9 @@ private:
     DBusProvider *dbusProvider_ = nullptr;
     bool available_ = false;
     QList<InputMethodEntry> inputMethods_;
-    QProcess *fcitx5Proc_;
+    // the engine cache holds inputMethods_ under the current stamp
+    bool engineCacheCurrent_ = false;
+    QProcess *fcitx5Proc_ = nullptr;
 };
 
 } // namespace dim
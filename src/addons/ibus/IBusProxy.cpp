@@ -9,7 +9,9 @@
 #include "addons/waylandserver/WaylandServer_public.h"
 #include "addons/wlfrontend/WLFrontend_public.h"
 #include "dimcore/Dim.h"
+#include "dimcore/EngineCache.h"
 #include "dimcore/InputContext.h"
+#include "dimcore/Tracer.h"
 #include "ibustypes.h"
 #include "wl/client/Compositor.h"
 #include "wl/client/ConnectionBase.h"
@@ -21,6 +23,8 @@
 
 #include <gio/gsettingsschema.h>
 
+#include <QDBusPendingCallWatcher>
+
 #include <functional>
 
 #include <signal.h>
@@ -42,6 +46,22 @@ DIM_ADDON_FACTORY(DimIBusProxy);
 
 static const std::string KEYBOARD_PREFIX = "xkb:";
 
+// the main thread also dispatches the key events, so a busy daemon must not stall it for the
+// 25 seconds of the default D-Bus timeout
+constexpr int BUS_CALL_TIMEOUT = 3000;
+
+// ibus-daemon rewrites its registry caches when engines are installed or removed, the component
+// directory covers systems without the caches
+static uint64_t registryStamp()
+{
+    return EngineCache::stamp({
+        QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/ibus/bus/registry"),
+        QStringLiteral("/var/cache/ibus/bus/registry"),
+        QStringLiteral("/usr/share/ibus/component"),
+    });
+}
+
 class DimIBusInputContextPrivate
 {
 public:
@@ -123,6 +143,7 @@ void DimIBusInputContextPrivate::createBusProxy()
             qWarning("ibus proxy: invalid bus.");
             return;
         }
+        busInterface_->setTimeout(BUS_CALL_TIMEOUT);
     }
 
     serviceWatcher_.removeWatchedService(ibusService_);
@@ -216,7 +237,8 @@ DimIBusProxy::DimIBusProxy(Dim *dim)
         im->inputMethodContextV1ForwardKeyCallback_ = std::bind(&DimIBusProxy::forwardKey,
                                                                 this,
                                                                 std::placeholders::_1,
-                                                                std::placeholders::_2);
+                                                                std::placeholders::_2,
+                                                                std::placeholders::_3);
         im->inputMethodContextV1CommitCallback_ =
             std::bind(&DimIBusProxy::commit, this, std::placeholders::_1, std::placeholders::_2);
         im->inputMethodContextV1PreeditCallback_ = std::bind(&DimIBusProxy::preedit,
@@ -281,17 +303,16 @@ DimIBusProxy::DimIBusProxy(Dim *dim)
             &QDBusServiceWatcher::serviceUnregistered,
             this,
             &DimIBusProxy::busUnregistered);
-    launchDaemon();
 }
 
-void DimIBusProxy::forwardKey(uint32_t keycode, uint32_t state)
+void DimIBusProxy::forwardKey(uint32_t serial, uint32_t keycode, uint32_t state)
 {
     auto *ic = getFocusedIC(focusedId_);
     if (!ic) {
         return;
     }
 
-    ic->forwardKey(keycode, state);
+    ic->forwardKey(keycode, state, serial);
 }
 
 void DimIBusProxy::commit(uint32_t serial, const char *text)
@@ -347,7 +368,21 @@ void DimIBusProxy::connectToBus()
     qDebug() << "connect to ibus";
 
     d->initBus();
+    if (d->busInterface_) {
+        connect(d->busInterface_,
+                &OrgFreedesktopIBusInterface::GlobalEngineChanged,
+                this,
+                &DimIBusProxy::globalEngineChanged,
+                Qt::UniqueConnection);
+    }
+
+    // the engine has to be set again on a new daemon, and its engines are listed once
+    currentEngine_.clear();
+    listedRegistryStamp_ = 0;
     initEngines();
+    if (!requestedEngine_.empty() && engineSwitchState_ == ENGINE_SWITCH_IDLE) {
+        sendGlobalEngine();
+    }
 
     if (!d->usePortal_ && socketWatcher_.files().size() == 0) {
         socketWatcher_.addPath(DimIBusInputContextPrivate::getSocketPath());
@@ -387,6 +422,7 @@ void DimIBusProxy::busUnregistered(const QString &str)
     qDebug() << "bus unregistered";
     Q_UNUSED(str);
     d->busConnected_ = false;
+    currentEngine_.clear();
 }
 
 DimIBusProxy::~DimIBusProxy()
@@ -397,6 +433,14 @@ DimIBusProxy::~DimIBusProxy()
 
 void DimIBusProxy::initInputMethods()
 {
+    // The live list replaces it once the daemon is connected, see initEngines(). Without a
+    // current cache the daemon is launched to list the engines, then it's left to the idle reaper.
+    engineCacheCurrent_ =
+        EngineCache::load(EngineCache::path(key()), registryStamp(), key(), inputMethods_)
+        == EngineCache::CURRENT;
+    if (!engineCacheCurrent_) {
+        requestDaemon();
+    }
     Q_EMIT addonInitFinished(this);
 
     std::unique_ptr<gchar *, Deleter<g_strfreev>> list(nullptr);
@@ -456,9 +500,16 @@ void DimIBusProxy::focusOut(uint32_t id)
 
 void DimIBusProxy::destroyed(uint32_t id)
 {
+    // the id may be handed out again with a new generation, don't keep it around
+    if (focusedId_ == id) {
+        focusedId_ = 0;
+    }
+
     if (isICDBusInterfaceValid(id)) {
+        DIM_TRACE_SCOPE("ibus", "Destroy");
         iBusICMap_[id]->Destroy();
     }
+    iBusICMap_.remove(id);
 }
 
 void DimIBusProxy::done() { }
@@ -479,16 +530,59 @@ void DimIBusProxy::contentType(uint32_t hint, uint32_t purpose)
 
 void DimIBusProxy::setCurrentIM(const std::string &im)
 {
-    if (!d->busConnected_ || d->usePortal_ || !d->busInterface_) {
+    // kept while the daemon isn't connected yet, connectToBus() sends it then
+    requestedEngine_ = im;
+
+    // sent when the switch in flight returns
+    if (engineSwitchState_ == ENGINE_SWITCH_PENDING || requestedEngine_ == currentEngine_) {
         return;
     }
 
-    QDBusPendingReply<> reply = d->busInterface_->SetGlobalEngine(QString::fromStdString(im));
-    reply.waitForFinished();
+    sendGlobalEngine();
+}
 
-    if (reply.isError()) {
-        qWarning() << "set global engine error" << reply.error();
+void DimIBusProxy::sendGlobalEngine()
+{
+    if (!d->busConnected_ || d->usePortal_ || !d->busInterface_) {
+        return;
     }
+
+    engineSwitchState_ = ENGINE_SWITCH_PENDING;
+    pendingEngine_ = requestedEngine_;
+    engineSwitchBeginUs_ = getMonotonicUs();
+
+    auto call = d->busInterface_->SetGlobalEngine(QString::fromStdString(pendingEngine_));
+    auto *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this](QDBusPendingCallWatcher *watcher) {
+                watcher->deleteLater();
+                engineSwitchState_ = ENGINE_SWITCH_IDLE;
+
+                QDBusPendingReply<> reply = *watcher;
+                if (reply.isError()) {
+                    qWarning() << "set global engine error"
+                               << QString::fromStdString(pendingEngine_) << reply.error();
+                } else {
+                    // currentEngine_ is set by GlobalEngineChanged, which arrives before the
+                    // reply and tells when another client switched the engine after us
+                    if (Tracer::isEnabled()) {
+                        // from the request to the switch taking effect
+                        Tracer::addSpan("ibus",
+                                        "SetGlobalEngine",
+                                        engineSwitchBeginUs_,
+                                        getMonotonicUs());
+                    }
+                    qDebug() << "ibus engine switched to"
+                             << QString::fromStdString(pendingEngine_);
+                }
+
+                // only the latest request matters, the ones in between have been dropped
+                if (requestedEngine_ != currentEngine_ && requestedEngine_ != pendingEngine_) {
+                    sendGlobalEngine();
+                }
+            });
 }
 
 bool DimIBusProxy::keyEvent([[maybe_unused]] const InputMethodEntry &entry,
@@ -505,11 +599,22 @@ bool DimIBusProxy::keyEvent([[maybe_unused]] const InputMethodEntry &entry,
         return false;
     }
 
-    context->sendKey(keyEvent.keycode(), keyEvent.isRelease());
+    keyEvent.setSerial(context->sendKey(keyEvent.keycode(), keyEvent.isRelease()));
 
     return true;
 }
 
+void DimIBusProxy::releaseKey(uint32_t id, uint32_t keycode)
+{
+    if (focusedId_ != id || !daemonLaunched_) {
+        return;
+    }
+
+    if (auto *context = wl_->inputMethodContextV1()) {
+        context->sendKey(keycode, true);
+    }
+}
+
 void DimIBusProxy::cursorRectangleChangeEvent(InputContextCursorRectChangeEvent &event)
 {
     if (!daemonLaunched_) {
@@ -522,6 +627,7 @@ void DimIBusProxy::cursorRectangleChangeEvent(InputContextCursorRectChangeEvent
         return;
     }
 
+    DIM_TRACE_SCOPE("ibus", "SetCursorLocationRelative");
     iBusICMap_[id]->SetCursorLocationRelative(event.x, event.y, event.w, event.h);
 }
 
@@ -538,72 +644,109 @@ void DimIBusProxy::updateSurroundingText(InputContextEvent &event)
         return;
     }
 
-    context->sendSurroundingText(surroundingText.text().toUtf8().data(),
+    context->sendSurroundingText(surroundingText.text().constData(),
                                  surroundingText.cursor(),
                                  surroundingText.anchor());
 }
 
 void DimIBusProxy::initEngines()
 {
-    QList<InputMethodEntry> inputMethods;
-    for (auto &engine : listEngines()) {
-        std::string imEntryName = engine.engine_name.toStdString();
-
-        // 过滤掉键盘布局
-        if (shouldBeIgnored(imEntryName)) {
-            continue;
-        }
+    if (d->usePortal_) {
+        return;
+    }
 
-        inputMethods.append(InputMethodEntry(key(),
-                                             imEntryName,
-                                             engine.longname.toStdString(),
-                                             engine.description.toStdString(),
-                                             engine.symbol.toStdString(),
-                                             engine.icon.toStdString()));
+    if (!d->busConnected_ || !d->busInterface_) {
+        qWarning() << "IBus is not connected!";
+        return;
     }
 
-    inputMethods_.swap(inputMethods);
-    Q_EMIT addonInitFinished(this);
-}
+    if (listingEngines_) {
+        listEnginesAgain_ = true;
+        return;
+    }
 
-void DimIBusProxy::globalEngineChanged(const QString &engineName)
-{
-    if (d->usePortal_ || !d->busConnected_) {
+    // no engine has been installed or removed since the last list
+    const uint64_t stamp = registryStamp();
+    if (stamp == listedRegistryStamp_) {
         return;
     }
 
-    initEngines();
-}
+    listingEngines_ = true;
+    listEnginesAgain_ = false;
 
-QList<IBusEngineDesc> DimIBusProxy::listEngines()
-{
-    QList<IBusEngineDesc> engines;
+    auto call = d->busInterface_->ListEngines();
+    auto *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, stamp](QDBusPendingCallWatcher *watcher) {
+                watcher->deleteLater();
+                listingEngines_ = false;
+
+                QDBusPendingReply<QVariantList> reply = *watcher;
+                if (reply.isError()) {
+                    qWarning() << "Bus::listEngines:" << reply.error();
+                } else {
+                    DIM_TRACE_SCOPE("ibus", "ListEngines");
+
+                    QList<InputMethodEntry> inputMethods;
+                    for (const auto &item : reply.value()) {
+                        IBusEngineDesc engine;
+                        item.value<QDBusArgument>() >> engine;
+
+                        std::string imEntryName = engine.engine_name.toStdString();
+
+                        // 过滤掉键盘布局
+                        if (shouldBeIgnored(imEntryName)) {
+                            continue;
+                        }
+
+                        inputMethods.append(InputMethodEntry(key(),
+                                                             imEntryName,
+                                                             engine.longname.toStdString(),
+                                                             engine.description.toStdString(),
+                                                             engine.symbol.toStdString(),
+                                                             engine.icon.toStdString()));
+                    }
 
-    if (d->usePortal_) {
-        return engines;
-    }
+                    listedRegistryStamp_ = stamp;
 
-    if (!d->busConnected_) {
-        qWarning() << "IBus is not connected!";
-        return engines;
-    }
+                    // usually the same as the cached list published at startup
+                    if (inputMethods != inputMethods_) {
+                        inputMethods_.swap(inputMethods);
+                        engineCacheCurrent_ = false;
+                        Q_EMIT addonInitFinished(this);
+                    }
+                    if (!engineCacheCurrent_) {
+                        engineCacheCurrent_ =
+                            EngineCache::save(EngineCache::path(key()), stamp, inputMethods_);
+                    }
+                }
 
-    QDBusPendingReply<QVariantList> reply = d->busInterface_->ListEngines();
-    reply.waitForFinished();
+                if (listEnginesAgain_) {
+                    initEngines();
+                }
+            });
+}
 
-    if (reply.isError()) {
-        qWarning() << "Bus::listEngines:" << reply.error();
-        return engines;
+void DimIBusProxy::globalEngineChanged(const QString &engineName)
+{
+    if (d->usePortal_ || !d->busConnected_) {
+        return;
     }
 
-    QVariantList ret = reply.value();
-    for (int i = 0; i < ret.size(); i++) {
-        IBusEngineDesc e;
-        ret.at(i).value<QDBusArgument>() >> e;
-        engines << e;
+    currentEngine_ = engineName.toStdString();
+
+    // the effect of our SetGlobalEngine, or of one we asked for before
+    if ((engineSwitchState_ == ENGINE_SWITCH_PENDING && currentEngine_ == pendingEngine_)
+        || currentEngine_ == requestedEngine_) {
+        return;
     }
 
-    return engines;
+    // Another ibus client switched the engine. It wins over our requests, the one in flight
+    // isn't sent again, and dim switches to its input method as if the user had chosen it.
+    requestedEngine_ = currentEngine_;
+    dim()->requestSwitchIM(key(), currentEngine_);
 }
 
 bool DimIBusProxy::shouldBeIgnored(const std::string &uniqueName) const
@@ -666,6 +809,12 @@ void DimIBusProxy::launchDaemon()
             });
 }
 
+void DimIBusProxy::stopDaemon()
+{
+    stopInputMethod();
+    daemonLaunched_ = false;
+}
+
 void DimIBusProxy::stopInputMethod()
 {
     if (!ibusDaemonProc_) {
@@ -674,13 +823,7 @@ void DimIBusProxy::stopInputMethod()
 
     disconnect(ibusDaemonProc_, nullptr, this, nullptr);
 
-    ibusDaemonProc_->terminate();
-    if (!ibusDaemonProc_->waitForFinished()) {
-        ibusDaemonProc_->kill();
-        ibusDaemonProc_->waitForFinished();
-    }
-
-    ibusDaemonProc_->deleteLater();
+    stopProcess(ibusDaemonProc_);
     ibusDaemonProc_ = nullptr;
 }
 
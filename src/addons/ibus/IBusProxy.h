@@ -19,7 +19,6 @@
 
 #include <memory>
 
-class IBusEngineDesc;
 class DimIBusInputContextPrivate;
 
 namespace org {
@@ -44,24 +43,29 @@ public:
     void updateSurroundingText(InputContextEvent &event) override;
     void cursorRectangleChangeEvent(InputContextCursorRectChangeEvent &event) override;
     void setCurrentIM(const std::string &im) override;
+    void releaseKey(uint32_t id, uint32_t keycode) override;
 
-    void forwardKey(uint32_t keycode, uint32_t state);
+    void forwardKey(uint32_t serial, uint32_t keycode, uint32_t state);
     void commit(uint32_t serial, const char *text);
     void preedit(uint32_t serial, const char *text, const char *commit);
     void panelCreate();
     void panelDestroy();
 
+protected:
+    void launchDaemon() override;
+    void stopDaemon() override;
+
 private:
-    QList<IBusEngineDesc> listEngines();
+    // Both are asynchronous. A refresh requested while ListEngines is in flight is done once
+    // it returns, an engine switch requested meanwhile replaces the one waiting to be sent.
     void initEngines();
+    void sendGlobalEngine();
 
     inline bool isICDBusInterfaceValid(uint32_t id)
     {
         return !iBusICMap_.isEmpty() && iBusICMap_.contains(id) && iBusICMap_[id]->isValid();
     }
 
-    void launchDaemon();
-
 public Q_SLOTS:
     void connectToBus();
     void socketChanged(const QString &str);
@@ -82,12 +86,32 @@ private:
     QFileSystemWatcher socketWatcher_;
     QTimer timer_;
     QList<InputMethodEntry> inputMethods_;
+    // the engine cache holds inputMethods_ under the current registry stamp
+    bool engineCacheCurrent_ = false;
     QMap<uint32_t, std::shared_ptr<OrgFreedesktopIBusInputContextInterface>> iBusICMap_;
     QProcess *ibusDaemonProc_ = nullptr;
     std::shared_ptr<WL_ADDONS_BASE_NAMESPACE::Server> wl_;
     QTimer daemonCrashTimer_;
     uint daemonCrashes_ = 0;
     uint32_t focusedId_ = 0;
+
+    enum EngineSwitchState {
+        ENGINE_SWITCH_IDLE,
+        // SetGlobalEngine of pendingEngine_ is in flight
+        ENGINE_SWITCH_PENDING,
+    };
+    EngineSwitchState engineSwitchState_ = ENGINE_SWITCH_IDLE;
+    // the latest engine asked for by setCurrentIM()
+    std::string requestedEngine_;
+    std::string pendingEngine_;
+    // the engine ibus has switched to
+    std::string currentEngine_;
+    uint64_t engineSwitchBeginUs_ = 0;
+    bool listingEngines_ = false;
+    bool listEnginesAgain_ = false;
+    // the registry stamp of the last ListEngines, it isn't called again until the stamp changes
+    // or a new daemon connects
+    uint64_t listedRegistryStamp_ = 0;
     std::unique_ptr<InputPopupSurfaceV2> popup_;
     wl_surface * surface_ = nullptr;
 };
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "KeyTranslationTable.h"
+
+#include "common/common.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace org::deepin::dim;
+
+// keys pressed with these modifiers are shortcuts of the application
+constexpr uint32_t SHORTCUT_MASK =
+    CONTROL_MASK | MOD1_MASK | MOD4_MASK | ALT_MASK | META_MASK | SUPER_MASK | HYPER_MASK;
+
+static const KeyTranslationTable::Translation PASSTHROUGH = { {}, true };
+
+static bool isControlCharacter(const char *text)
+{
+    auto c = static_cast<unsigned char>(text[0]);
+    return c < 0x20 || c == 0x7f;
+}
+
+static xkb_mod_mask_t modMask(xkb_keymap *keymap, const char *name)
+{
+    xkb_mod_index_t index = xkb_keymap_mod_get_index(keymap, name);
+    return index == XKB_MOD_INVALID ? 0 : 1 << index;
+}
+
+KeyTranslationTable::KeyTranslationTable(uint32_t groups)
+    : groups_(groups)
+    , translations_(groups * LEVEL_CNT * KEYCODE_CNT, PASSTHROUGH)
+{
+}
+
+KeyTranslationTable::~KeyTranslationTable() = default;
+
+std::unique_ptr<KeyTranslationTable> KeyTranslationTable::build(xkb_keymap *keymap)
+{
+    std::unique_ptr<xkb_state, Deleter<xkb_state_unref>> state(xkb_state_new(keymap));
+    if (!state) {
+        return nullptr;
+    }
+
+    const xkb_mod_mask_t shift = modMask(keymap, XKB_MOD_NAME_SHIFT);
+    const xkb_mod_mask_t lock = modMask(keymap, XKB_MOD_NAME_CAPS);
+    // AltGr is mapped to LevelThree, which is Mod5 in the xkeyboard-config keymaps
+    const xkb_mod_mask_t altGr = modMask(keymap, "Mod5");
+
+    const uint32_t groups = std::max<uint32_t>(xkb_keymap_num_layouts(keymap), 1);
+    std::unique_ptr<KeyTranslationTable> table(new KeyTranslationTable(groups));
+
+    for (uint32_t group = 0; group < groups; group++) {
+        for (uint32_t level = 0; level < LEVEL_CNT; level++) {
+            const xkb_mod_mask_t depressed =
+                (level & LEVEL_SHIFT ? shift : 0) | (level & LEVEL_ALTGR ? altGr : 0);
+            const xkb_mod_mask_t locked = level & LEVEL_LOCK ? lock : 0;
+            xkb_state_update_mask(state.get(), depressed, 0, locked, 0, 0, group);
+
+            auto *translations = &table->translations_[(group * LEVEL_CNT + level) * KEYCODE_CNT];
+            for (uint32_t keycode = 0; keycode < KEYCODE_CNT; keycode++) {
+                char buf[64];
+                int size = xkb_state_key_get_utf8(state.get(),
+                                                  keycode + XKB_HISTORICAL_OFFSET,
+                                                  buf,
+                                                  sizeof(buf));
+                auto &translation = translations[keycode];
+                if (size <= 0 || size >= static_cast<int>(sizeof(translation.text))
+                    || isControlCharacter(buf)) {
+                    continue;
+                }
+
+                memcpy(translation.text, buf, size + 1);
+                translation.passthrough = false;
+            }
+        }
+    }
+
+    return table;
+}
+
+uint32_t KeyTranslationTable::levelFromModifiers(uint32_t modifiers)
+{
+    return (modifiers & SHIFT_MASK ? LEVEL_SHIFT : 0) | (modifiers & LOCK_MASK ? LEVEL_LOCK : 0)
+        | (modifiers & MOD5_MASK ? LEVEL_ALTGR : 0);
+}
+
+const KeyTranslationTable::Translation &
+KeyTranslationTable::translate(uint32_t keycode, uint32_t modifiers, uint32_t group) const
+{
+    if (keycode >= KEYCODE_CNT || (modifiers & SHORTCUT_MASK)) {
+        return PASSTHROUGH;
+    }
+
+    group = group < groups_ ? group : 0;
+
+    return translations_[(group * LEVEL_CNT + levelFromModifiers(modifiers)) * KEYCODE_CNT
+                         + keycode];
+}
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef KEYTRANSLATIONTABLE_H
+#define KEYTRANSLATIONTABLE_H
+
+#include <xkbcommon/xkbcommon.h>
+
+#include <memory>
+#include <vector>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Flat evdev keycode -> UTF-8 tables of a compiled layout, one table per (group, shift level).
+// The tables are built once when a layout is activated, so translating a key press is a single
+// array lookup.
+class KeyTranslationTable
+{
+public:
+    struct Translation
+    {
+        char text[7]; // NUL-terminated UTF-8
+        bool passthrough; // no text or a control character, the key should go to the application
+    };
+
+    // shift levels are a combination of the modifiers which select the symbol of a key
+    enum Level {
+        LEVEL_SHIFT = 1 << 0,
+        LEVEL_LOCK = 1 << 1,
+        LEVEL_ALTGR = 1 << 2,
+
+        LEVEL_CNT = 1 << 3,
+    };
+
+    static constexpr uint32_t KEYCODE_CNT = 256;
+
+    static std::unique_ptr<KeyTranslationTable> build(xkb_keymap *keymap);
+
+    ~KeyTranslationTable();
+
+    // modifiers is the dim modifier mask (see ModifiersMask in common.h)
+    const Translation &translate(uint32_t keycode, uint32_t modifiers, uint32_t group = 0) const;
+
+private:
+    explicit KeyTranslationTable(uint32_t groups);
+
+    static uint32_t levelFromModifiers(uint32_t modifiers);
+
+private:
+    uint32_t groups_;
+    // indexed by [group][level][keycode]
+    std::vector<Translation> translations_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !KEYTRANSLATIONTABLE_H
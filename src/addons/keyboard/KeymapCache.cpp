@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "KeymapCache.h"
+
+#include "common/common.h"
+#include "config.h"
+
+using namespace org::deepin::dim;
+
+static std::pair<std::string, std::string> splitLayout(const std::string &layout)
+{
+    auto pos = layout.find_first_of('_');
+    if (pos == std::string::npos) {
+        return { layout, "" };
+    }
+
+    return {
+        { layout.cbegin(), layout.cbegin() + pos },
+        { layout.cbegin() + pos + 1, layout.cend() },
+    };
+}
+
+KeymapCache::KeymapCache(xkb_context *ctx, size_t capacity)
+    : ctx_(ctx)
+    , capacity_(capacity)
+{
+}
+
+KeymapCache::~KeymapCache() = default;
+
+std::unique_ptr<KeyTranslationTable> KeymapCache::compile(xkb_context *ctx,
+                                                          const std::string &layout)
+{
+    const auto [layoutName, variantName] = splitLayout(layout);
+
+    struct xkb_rule_names names;
+    names.layout = layoutName.c_str();
+    names.variant = variantName.c_str();
+    names.rules = DEFAULT_XKB_RULES;
+    names.model = "";
+    names.options = "";
+
+    std::unique_ptr<xkb_keymap, Deleter<xkb_keymap_unref>> keymap(
+        xkb_keymap_new_from_names(ctx, &names, XKB_KEYMAP_COMPILE_NO_FLAGS));
+    if (!keymap) {
+        return nullptr;
+    }
+
+    return KeyTranslationTable::build(keymap.get());
+}
+
+const KeyTranslationTable *KeymapCache::find(const std::string &layout)
+{
+    auto iter = index_.find(layout);
+    if (iter == index_.end()) {
+        return nullptr;
+    }
+
+    // move to the front of the LRU list
+    lru_.splice(lru_.begin(), lru_, iter->second);
+
+    return iter->second->second.get();
+}
+
+const KeyTranslationTable *KeymapCache::get(const std::string &layout)
+{
+    const auto *table = find(layout);
+    if (table) {
+        return table;
+    }
+
+    auto newTable = compile(ctx_, layout);
+    if (!newTable) {
+        return nullptr;
+    }
+
+    if (capacity_ == 0) {
+        uncached_ = std::move(newTable);
+        return uncached_.get();
+    }
+
+    insert(layout, std::move(newTable));
+
+    return lru_.front().second.get();
+}
+
+void KeymapCache::prefetch(const std::string &layout)
+{
+    get(layout);
+}
+
+void KeymapCache::insert(const std::string &layout, std::unique_ptr<KeyTranslationTable> table)
+{
+    if (capacity_ == 0 || index_.find(layout) != index_.end()) {
+        return;
+    }
+
+    lru_.emplace_front(layout, std::move(table));
+    index_.emplace(layout, lru_.begin());
+    shrink();
+}
+
+void KeymapCache::setCapacity(size_t capacity)
+{
+    capacity_ = capacity;
+    shrink();
+}
+
+void KeymapCache::shrink()
+{
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef KEYMAPCACHE_H
+#define KEYMAPCACHE_H
+
+#include "KeyTranslationTable.h"
+
+#include <xkbcommon/xkbcommon.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// LRU cache of compiled layouts, keyed by the layout name ("layout" or "layout_variant").
+// A compiled layout is kept as its key translation tables, the xkb keymap is only needed to
+// build them.
+class KeymapCache
+{
+public:
+    KeymapCache(xkb_context *ctx, size_t capacity);
+    ~KeymapCache();
+
+    // Compiles a layout. It only touches ctx, so it can run in a worker thread with its own
+    // context.
+    static std::unique_ptr<KeyTranslationTable> compile(xkb_context *ctx,
+                                                        const std::string &layout);
+
+    // Looks up a compiled layout without compiling, returns nullptr on a miss.
+    const KeyTranslationTable *find(const std::string &layout);
+    // Looks up a compiled layout, compiling it on a miss. Returns nullptr if compiling fails.
+    const KeyTranslationTable *get(const std::string &layout);
+    void prefetch(const std::string &layout);
+    void insert(const std::string &layout, std::unique_ptr<KeyTranslationTable> table);
+
+    size_t capacity() const { return capacity_; }
+
+    void setCapacity(size_t capacity);
+
+    size_t size() const { return lru_.size(); }
+
+private:
+    using LruList = std::list<std::pair<std::string, std::unique_ptr<KeyTranslationTable>>>;
+
+    void shrink();
+
+private:
+    xkb_context *ctx_;
+    size_t capacity_;
+    LruList lru_;
+    std::unordered_map<std::string, LruList::iterator> index_;
+    // used when the cache is disabled (capacity 0), keeps the last compiled layout alive
+    std::unique_ptr<KeyTranslationTable> uncached_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !KEYMAPCACHE_H
@@ -0,0 +1,349 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "XkbCatalog.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace org::deepin::dim;
+
+static const char CATALOG_MAGIC[8] = { 'D', 'I', 'M', 'X', 'K', 'B', 'C', '\0' };
+constexpr uint32_t CATALOG_VERSION = 1;
+
+struct CatalogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t stamp;
+    uint32_t entriesOffset;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+
+// offsets into the string pool
+struct CatalogEntry
+{
+    uint32_t name;
+    uint32_t label;
+    uint32_t description;
+};
+
+namespace {
+
+class CatalogWriter
+{
+public:
+    CatalogWriter()
+    {
+        // offset 0 is the empty string
+        strings_.push_back('\0');
+    }
+
+    void add(const QString &name, const QString &label, const QString &description)
+    {
+        entries_.push_back({ intern(name), intern(label), intern(description) });
+    }
+
+    QByteArray finish(uint64_t stamp) const
+    {
+        CatalogHeader header;
+        memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+        header.version = CATALOG_VERSION;
+        header.entryCount = entries_.size();
+        header.stamp = stamp;
+        header.entriesOffset = sizeof(CatalogHeader);
+        header.stringsOffset = header.entriesOffset + entries_.size() * sizeof(CatalogEntry);
+        header.stringsSize = strings_.size();
+        header.reserved = 0;
+
+        QByteArray data;
+        data.reserve(header.stringsOffset + header.stringsSize);
+        data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        data.append(reinterpret_cast<const char *>(entries_.data()),
+                    entries_.size() * sizeof(CatalogEntry));
+        data.append(strings_.data(), strings_.size());
+
+        return data;
+    }
+
+private:
+    uint32_t intern(const QString &str)
+    {
+        if (str.isEmpty()) {
+            return 0;
+        }
+
+        auto utf8 = str.toStdString();
+        auto iter = offsets_.find(utf8);
+        if (iter != offsets_.end()) {
+            return iter->second;
+        }
+
+        uint32_t offset = strings_.size();
+        strings_.insert(strings_.end(), utf8.cbegin(), utf8.cend());
+        strings_.push_back('\0');
+        offsets_.emplace(std::move(utf8), offset);
+
+        return offset;
+    }
+
+private:
+    std::vector<CatalogEntry> entries_;
+    std::vector<char> strings_;
+    std::unordered_map<std::string, uint32_t> offsets_;
+};
+
+} // namespace
+
+static void parseVariantList(CatalogWriter &writer,
+                             const QString &layoutName,
+                             const QDomElement &variantListEle)
+{
+    for (auto variantEle = variantListEle.firstChildElement("variant"); !variantEle.isNull();
+         variantEle = variantEle.nextSiblingElement("variant")) {
+        auto configItemEle = variantEle.firstChildElement("configItem");
+
+        const QString name = configItemEle.firstChildElement("name").text();
+        const QString shortDescription = configItemEle.firstChildElement("shortDescription").text();
+        const QString description = configItemEle.firstChildElement("description").text();
+
+        writer.add(layoutName + "_" + name,
+                   shortDescription.isEmpty() ? name : shortDescription,
+                   description);
+    }
+}
+
+static void parseLayoutList(CatalogWriter &writer, const QDomElement &layoutListEle)
+{
+    for (auto layoutEle = layoutListEle.firstChildElement("layout"); !layoutEle.isNull();
+         layoutEle = layoutEle.nextSiblingElement("layout")) {
+        auto configItemEle = layoutEle.firstChildElement("configItem");
+
+        const QString name = configItemEle.firstChildElement("name").text();
+        const QString shortDescription = configItemEle.firstChildElement("shortDescription").text();
+        const QString description = configItemEle.firstChildElement("description").text();
+
+        writer.add(name, shortDescription.isEmpty() ? name : shortDescription, description);
+
+        parseVariantList(writer, name, layoutEle.firstChildElement("variantList"));
+    }
+}
+
+static void parseRule(CatalogWriter &writer, const QString &file)
+{
+    QFile xmlFile(file);
+    if (!xmlFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+
+    QDomDocument xmlReader;
+    xmlReader.setContent(&xmlFile);
+    auto layoutListEle = xmlReader.documentElement().firstChildElement("layoutList");
+
+    parseLayoutList(writer, layoutListEle);
+}
+
+XkbCatalog::XkbCatalog() = default;
+
+XkbCatalog::~XkbCatalog()
+{
+    unmap();
+}
+
+uint64_t XkbCatalog::stamp(const QStringList &ruleFiles)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    auto mix = [&hash](const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3;
+        }
+    };
+
+    for (const auto &file : ruleFiles) {
+        QFileInfo info(file);
+        const QByteArray path = info.absoluteFilePath().toUtf8();
+        const qint64 size = info.exists() ? info.size() : -1;
+        const qint64 mtime = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+
+        mix(path.constData(), path.size());
+        mix(&size, sizeof(size));
+        mix(&mtime, sizeof(mtime));
+    }
+
+    return hash;
+}
+
+QByteArray XkbCatalog::compile(const QStringList &ruleFiles, uint64_t stamp)
+{
+    CatalogWriter writer;
+    for (const auto &file : ruleFiles) {
+        parseRule(writer, file);
+    }
+
+    return writer.finish(stamp);
+}
+
+bool XkbCatalog::open(const QStringList &ruleFiles, const QString &cachePath)
+{
+    unmap();
+
+    const uint64_t rulesStamp = stamp(ruleFiles);
+    if (map(cachePath, rulesStamp)) {
+        return true;
+    }
+
+    buffer_ = compile(ruleFiles, rulesStamp);
+
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QSaveFile file(cachePath);
+    if (file.open(QIODevice::WriteOnly) && file.write(buffer_) == buffer_.size()
+        && file.commit()) {
+        if (map(cachePath, rulesStamp)) {
+            buffer_.clear();
+            return true;
+        }
+    } else {
+        qWarning() << "failed to write xkb catalog" << cachePath;
+    }
+
+    // keep using the catalog from memory
+    data_ = buffer_.constData();
+    size_ = buffer_.size();
+
+    return validate(data_, size_, rulesStamp);
+}
+
+bool XkbCatalog::map(const QString &path, uint64_t stamp)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CatalogHeader))) {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    if (!validate(static_cast<const char *>(data), st.st_size, stamp)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    data_ = static_cast<const char *>(data);
+    size_ = st.st_size;
+    mapped_ = true;
+
+    return true;
+}
+
+bool XkbCatalog::validate(const char *data, size_t size, uint64_t stamp) const
+{
+    if (size < sizeof(CatalogHeader)) {
+        return false;
+    }
+
+    const auto *header = reinterpret_cast<const CatalogHeader *>(data);
+    if (memcmp(header->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0
+        || header->version != CATALOG_VERSION || header->stamp != stamp) {
+        return false;
+    }
+
+    const uint64_t entriesEnd =
+        header->entriesOffset + uint64_t(header->entryCount) * sizeof(CatalogEntry);
+    if (header->entriesOffset < sizeof(CatalogHeader) || entriesEnd > header->stringsOffset
+        || header->stringsSize == 0
+        || uint64_t(header->stringsOffset) + header->stringsSize != size) {
+        return false;
+    }
+
+    // every string is terminated by the last NUL of the pool, so offsets only need a bounds check
+    const char *strings = data + header->stringsOffset;
+    if (strings[header->stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    const auto *entries = reinterpret_cast<const CatalogEntry *>(data + header->entriesOffset);
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const auto &entry = entries[i];
+        if (entry.name >= header->stringsSize || entry.label >= header->stringsSize
+            || entry.description >= header->stringsSize) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void XkbCatalog::unmap()
+{
+    if (mapped_) {
+        munmap(const_cast<char *>(data_), size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+}
+
+uint32_t XkbCatalog::size() const
+{
+    if (!data_) {
+        return 0;
+    }
+
+    return reinterpret_cast<const CatalogHeader *>(data_)->entryCount;
+}
+
+std::string_view XkbCatalog::string(uint32_t offset) const
+{
+    const auto *header = reinterpret_cast<const CatalogHeader *>(data_);
+    return data_ + header->stringsOffset + offset;
+}
+
+std::string_view XkbCatalog::name(uint32_t i) const
+{
+    const auto *header = reinterpret_cast<const CatalogHeader *>(data_);
+    return string(reinterpret_cast<const CatalogEntry *>(data_ + header->entriesOffset)[i].name);
+}
+
+std::string_view XkbCatalog::label(uint32_t i) const
+{
+    const auto *header = reinterpret_cast<const CatalogHeader *>(data_);
+    return string(reinterpret_cast<const CatalogEntry *>(data_ + header->entriesOffset)[i].label);
+}
+
+std::string_view XkbCatalog::description(uint32_t i) const
+{
+    const auto *header = reinterpret_cast<const CatalogHeader *>(data_);
+    return string(
+        reinterpret_cast<const CatalogEntry *>(data_ + header->entriesOffset)[i].description);
+}
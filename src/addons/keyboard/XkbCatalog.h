@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef XKBCATALOG_H
+#define XKBCATALOG_H
+
+#include <QByteArray>
+#include <QStringList>
+
+#include <string_view>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Compiled list of the layouts described by the xkb rules files (evdev.xml, evdev.extras.xml).
+//
+// Parsing the XML files is slow, so the list is compiled once into a binary file which is
+// memory-mapped on the next start. The file records a stamp of the rules files' paths, sizes and
+// mtimes and is regenerated when they change.
+class XkbCatalog
+{
+public:
+    XkbCatalog();
+    ~XkbCatalog();
+
+    // Opens the compiled catalog at cachePath, compiling it first if it is missing or stale.
+    bool open(const QStringList &ruleFiles, const QString &cachePath);
+
+    uint32_t size() const;
+    // "layout" or "layout_variant"
+    std::string_view name(uint32_t i) const;
+    std::string_view label(uint32_t i) const;
+    // untranslated, use the xkeyboard-config gettext domain to translate it
+    std::string_view description(uint32_t i) const;
+
+private:
+    static uint64_t stamp(const QStringList &ruleFiles);
+    static QByteArray compile(const QStringList &ruleFiles, uint64_t stamp);
+    bool map(const QString &path, uint64_t stamp);
+    bool validate(const char *data, size_t size, uint64_t stamp) const;
+    void unmap();
+    std::string_view string(uint32_t offset) const;
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    // holds the catalog when it could not be written to the cache
+    QByteArray buffer_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !XKBCATALOG_H
@@ -5,6 +5,8 @@
 #include "keyboard.h"
 
 #include "config.h"
+#include "dimcore/Dconfig.h"
+#include "dimcore/Dim.h"
 #include "dimcore/Events.h"
 #include "dimcore/InputContext.h"
 #include "dimcore/InputMethodEntry.h"
@@ -14,34 +16,22 @@
 #undef XK_MISCELLANY
 
 #include <common/common.h>
-#include <libintl.h>
 
 #include <QDir>
-#include <QDomDocument>
 #include <QList>
+#include <QStandardPaths>
 
 using namespace org::deepin::dim;
 
-constexpr uint32_t BUFF_SIZE = 100;
+constexpr int DEFAULT_KEYMAP_CACHE_SIZE = 8;
 
-DIM_ADDON_FACTORY(Keyboard)
-
-struct Variant
-{
-    QString name;
-    QString shortDescription;
-    QString description;
-    QList<QString> languageList;
-};
+#ifdef Dtk6Core_FOUND
+const QString DimDConfigAppID = QStringLiteral("org.deepin.dde.dim");
+const QString DimDConfigJson = QStringLiteral("org.deepin.dde.dim");
+const QString KeyKeymapCacheSize = QStringLiteral("KeymapCacheSize");
+#endif
 
-struct Layout
-{
-    QString name;
-    QString shortDescription;
-    QString description;
-    QList<QString> languageList;
-    QList<Variant> variantList;
-};
+DIM_ADDON_FACTORY(Keyboard)
 
 Keyboard::Keyboard(Dim *dim)
     : InputMethodAddon(dim, "keyboard", "keyboard")
@@ -52,19 +42,38 @@ Keyboard::Keyboard(Dim *dim)
         throw std::runtime_error("Failed to create xkb context");
     }
 
-    keymap_.reset(nullptr);
-    state_.reset(nullptr);
+    int cacheSize = DEFAULT_KEYMAP_CACHE_SIZE;
+#ifdef Dtk6Core_FOUND
+    cacheSize = DconfigSettings::ConfigValue(DimDConfigAppID,
+                                             DimDConfigJson,
+                                             KeyKeymapCacheSize,
+                                             DEFAULT_KEYMAP_CACHE_SIZE)
+                    .toInt();
+#endif
+    keymapCache_ = std::make_unique<KeymapCache>(ctx_.get(), std::max(cacheSize, 0));
+
+    prefetchPool_.setMaxThreadCount(1);
+
+    // compile the keymaps of the enabled layouts before the first key press
+    connect(dim, &Dim::inputMethodEntryChanged, this, &Keyboard::prefetchActiveLayouts);
 
     QDir dir(QStringLiteral(XKEYBOARDCONFIG_XKBBASE) + QDir::separator() + "rules");
     QString rules = dir.absoluteFilePath(QString("%1.xml").arg(DEFAULT_XKB_RULES));
     QString extraRules = dir.absoluteFilePath(QString("%1.extras.xml").arg(DEFAULT_XKB_RULES));
 
-    parseRule(rules);
-    parseRule(extraRules);
+    QString cachePath = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/deepin-im/xkb-%1.catalog").arg(DEFAULT_XKB_RULES);
+
+    catalog_.open({ rules, extraRules }, cachePath);
 }
 
 Keyboard::~Keyboard()
 {
+    // the queued results are discarded with the object
+    prefetchCancelled_ = true;
+    prefetchPool_.clear();
+    prefetchPool_.waitForDone();
+
     keyboards_.clear();
 }
 
@@ -75,20 +84,134 @@ const QList<InputMethodEntry> &Keyboard::getInputMethods()
 
 void Keyboard::initInputMethods()
 {
+    keyboards_.clear();
+
+    // the other layouts in use are published when dim activates them
+    for (uint32_t i = 0; i < catalog_.size(); i++) {
+        if (catalog_.name(i) == "us") {
+            keyboards_.append(catalogEntry(i));
+            break;
+        }
+    }
+
     Q_EMIT addonInitFinished(this);
 }
 
-static std::pair<std::string, std::string> splitLayout(const std::string &layout)
+QList<InputMethodEntry> Keyboard::availableInputMethods()
+{
+    QList<InputMethodEntry> keyboards;
+    keyboards.reserve(catalog_.size());
+
+    for (uint32_t i = 0; i < catalog_.size(); i++) {
+        keyboards.append(catalogEntry(i));
+    }
+
+    return keyboards;
+}
+
+bool Keyboard::publishInputMethod(const std::string &name)
+{
+    for (const auto &entry : keyboards_) {
+        if (entry.uniqueName() == name) {
+            return true;
+        }
+    }
+
+    for (uint32_t i = 0; i < catalog_.size(); i++) {
+        if (catalog_.name(i) == name) {
+            keyboards_.append(catalogEntry(i));
+            Q_EMIT addonInitFinished(this);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+InputMethodEntry Keyboard::catalogEntry(uint32_t i) const
+{
+    const std::string name(catalog_.name(i));
+
+    // descriptions are translated when they are first displayed
+    return InputMethodEntry(key(),
+                            name,
+                            name,
+                            std::string(catalog_.description(i)),
+                            std::string(catalog_.label(i)),
+                            "input-keyboard",
+                            "xkeyboard-config");
+}
+
+void Keyboard::setCurrentIM(const std::string &im)
+{
+    if (im == "us") {
+        return;
+    }
+
+    keymapCache_->prefetch(im);
+}
+
+void Keyboard::prefetchActiveLayouts()
 {
-    auto pos = layout.find_first_of('_');
-    if (pos == std::string::npos) {
-        return { layout, "" };
+    if (prefetching_) {
+        prefetchAgain_ = true;
+        return;
+    }
+
+    std::vector<std::string> layouts;
+    for (const auto &im : dim()->activeInputMethodEntries()) {
+        const auto &layout = im.name();
+        if (im.addon() != key() || layout == "us" || keymapCache_->find(layout)) {
+            continue;
+        }
+
+        // don't let prefetching evict the layouts which are in use
+        if (keymapCache_->size() + layouts.size() >= keymapCache_->capacity()) {
+            break;
+        }
+
+        layouts.emplace_back(layout);
+    }
+
+    if (layouts.empty()) {
+        return;
     }
 
-    return {
-        { layout.cbegin(), layout.cbegin() + pos },
-        { layout.cbegin() + pos + 1, layout.cend() },
-    };
+    // compile in the background, xkb contexts are not thread-safe so the worker uses its own
+    prefetching_ = true;
+    prefetchPool_.start([this, layouts]() {
+        std::unique_ptr<xkb_context, Deleter<xkb_context_unref>> ctx(
+            xkb_context_new(XKB_CONTEXT_NO_FLAGS));
+
+        for (const auto &layout : layouts) {
+            if (prefetchCancelled_) {
+                return;
+            }
+
+            auto table = ctx ? KeymapCache::compile(ctx.get(), layout) : nullptr;
+            if (!table) {
+                continue;
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, layout, table = std::move(table)]() mutable {
+                    keymapCache_->insert(layout, std::move(table));
+                },
+                Qt::QueuedConnection);
+        }
+
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                prefetching_ = false;
+                if (prefetchAgain_) {
+                    prefetchAgain_ = false;
+                    prefetchActiveLayouts();
+                }
+            },
+            Qt::QueuedConnection);
+    });
 }
 
 static bool keysymIsModifier(uint32_t keysym)
@@ -111,115 +234,28 @@ bool Keyboard::keyEvent(const InputMethodEntry &entry, InputContextKeyEvent &key
         return false;
     }
 
-    struct xkb_rule_names names;
     const auto &layout = entry.name();
     if (layout == "us") {
         return false;
     }
 
-    const auto [layoutName, variantName] = splitLayout(layout);
-
-    names.layout = layoutName.c_str();
-    names.variant = variantName.c_str();
-    names.rules = DEFAULT_XKB_RULES;
-    names.model = "";
-    names.options = "";
-    keymap_.reset(xkb_keymap_new_from_names(ctx_.get(), &names, XKB_KEYMAP_COMPILE_NO_FLAGS));
-
-    keymap_ ? state_.reset(xkb_state_new(keymap_.get())) : state_.reset();
-
-    if (state_) {
-        char buf[BUFF_SIZE] = {};
-        xkb_keysym_to_utf8(keyEvent.keySym(), buf, BUFF_SIZE);
-        if (buf[0] == '\n' || buf[0] == '\r' || buf[0] == '\b' || buf[0] == '\033'
-            || buf[0] == '\x7f') {
-            return false;
-        }
-
-        ic->commitString(buf);
-        ic->commit();
-
-        return true;
-    }
-
-    return false;
-}
-
-void Keyboard::updateSurroundingText(InputContextEvent &event) { }
-
-// static QList<QString> parseLanguageList(const QDomElement &languageListEle) {
-//     QList<QString> languageList;
-//     for (auto language = languageListEle.firstChildElement("iso639Id"); !language.isNull();
-//          language = language.nextSiblingElement("iso639Id")) {
-//         auto languageName = language.text();
-//         languageList.append(languageName);
-//     }
-
-//     return languageList;
-// }
-
-void Keyboard::parseLayoutList(const QDomElement &layoutListEle)
-{
-    for (auto layoutEle = layoutListEle.firstChildElement("layout"); !layoutEle.isNull();
-         layoutEle = layoutEle.nextSiblingElement("layout")) {
-        auto configItemEle = layoutEle.firstChildElement("configItem");
-
-        const std::string name = configItemEle.firstChildElement("name").text().toStdString();
-        const std::string shortDescription =
-            configItemEle.firstChildElement("shortDescription").text().toStdString();
-        const auto label = shortDescription.empty() ? name : shortDescription;
-        const std::string description =
-            configItemEle.firstChildElement("description").text().toStdString();
-        // QString languageList =
-        // parseLanguageList(configItemEle.firstChildElement("languageList"));
-
-        keyboards_.append(InputMethodEntry(key(),
-                                           name,
-                                           name,
-                                           dgettext("xkeyboard-config", description.c_str()),
-                                           label,
-                                           "input-keyboard"));
-
-        parseVariantList(name, layoutEle.firstChildElement("variantList"));
-    }
-}
-
-void Keyboard::parseVariantList(const std::string &layoutName, const QDomElement &variantListEle)
-{
-    for (auto variantEle = variantListEle.firstChildElement("variant"); !variantEle.isNull();
-         variantEle = variantEle.nextSiblingElement("variant")) {
-        auto configItemEle = variantEle.firstChildElement("configItem");
-
-        const std::string name = configItemEle.firstChildElement("name").text().toStdString();
-        const std::string shortDescription =
-            configItemEle.firstChildElement("shortDescription").text().toStdString();
-        const auto label = shortDescription.empty() ? name : shortDescription;
-        const std::string description =
-            configItemEle.firstChildElement("description").text().toStdString();
-        // QString languageList =
-        // parseLanguageList(configItemEle.firstChildElement("languageList"));
-
-        const std::string fullname = layoutName + "_" + name;
-
-        keyboards_.append(InputMethodEntry(key(),
-                                           fullname,
-                                           fullname,
-                                           dgettext("xkeyboard-config", description.c_str()),
-                                           label,
-                                           "input-keyboard"));
+    // the layout is normally compiled when it is selected, get() only compiles it here if it has
+    // been evicted from the cache
+    const auto *table = keymapCache_->get(layout);
+    if (!table) {
+        return false;
     }
-}
 
-void Keyboard::parseRule(const QString &file)
-{
-    QFile xmlFile(file);
-    if (!xmlFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return;
+    // the compiled keymap only holds the selected layout, so it always uses group 0
+    const auto &translation = table->translate(keyEvent.keycode(), keyEvent.state());
+    if (translation.passthrough) {
+        return false;
     }
 
-    QDomDocument xmlReader;
-    xmlReader.setContent(&xmlFile);
-    auto layoutListEle = xmlReader.documentElement().firstChildElement("layoutList");
+    ic->commitString(translation.text);
+    ic->commit();
 
-    parseLayoutList(layoutListEle);
+    return true;
 }
+
+void Keyboard::updateSurroundingText(InputContextEvent &event) { }
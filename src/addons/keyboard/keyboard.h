@@ -5,12 +5,16 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 
+#include "KeymapCache.h"
+#include "XkbCatalog.h"
 #include "common/common.h"
 
 #include <dimcore/InputMethodAddon.h>
 #include <xkbcommon/xkbcommon.h>
 
-class QDomElement;
+#include <QThreadPool>
+
+#include <atomic>
 
 namespace org {
 namespace deepin {
@@ -26,16 +30,25 @@ public:
     void initInputMethods() override;
     bool keyEvent(const InputMethodEntry &entry, InputContextKeyEvent &keyEvent) override;
     void updateSurroundingText(InputContextEvent &event) override;
+    void setCurrentIM(const std::string &im) override;
+    QList<InputMethodEntry> availableInputMethods() override;
+    bool publishInputMethod(const std::string &name) override;
 
 private:
-    void parseRule(const QString &file);
-    void parseLayoutList(const QDomElement &layoutListEle);
-    void parseVariantList(const std::string &layoutName, const QDomElement &variantListEle);
+    void prefetchActiveLayouts();
+    InputMethodEntry catalogEntry(uint32_t i) const;
 
 private:
     std::unique_ptr<struct xkb_context, Deleter<xkb_context_unref>> ctx_;
-    std::unique_ptr<struct xkb_keymap, Deleter<xkb_keymap_unref>> keymap_;
-    std::unique_ptr<struct xkb_state, Deleter<xkb_state_unref>> state_;
+    std::unique_ptr<KeymapCache> keymapCache_;
+    // the prefetch runs in its own pool, so that the destructor can wait for it
+    QThreadPool prefetchPool_;
+    std::atomic<bool> prefetchCancelled_ = false;
+    bool prefetching_ = false;
+    // the active layouts changed during the prefetch
+    bool prefetchAgain_ = false;
+    XkbCatalog catalog_;
+    // only the layouts in use, the others are read from the catalog when they are listed
     QList<InputMethodEntry> keyboards_;
 };
 
@@ -49,35 +49,24 @@ TrayIcon::TrayIcon(Dim *dim)
     connect(dim,
             &Dim::inputMethodEntryChanged,
             this,
-            [this, &imList = dim->activeInputMethodEntries(), &imEntries = dim->imEntries()]() {
-                for (auto it = imList.begin(); it != imList.cend(); ++it) {
-                    auto iter =
-                        std::find_if(trayIconIMEntries_.cbegin(),
-                                     trayIconIMEntries_.cend(),
-                                     [&it](TrayIconInputMethodEntry *entry) {
-                                         return entry->addon() == QString::fromStdString(it->first)
-                                             && entry->name() == QString::fromStdString(it->second);
-                                     });
-                    if (iter != trayIconIMEntries_.cend()) {
+            [this, &imList = dim->activeInputMethodEntries()]() {
+                for (const auto &im : imList) {
+                    if (trayIconIMIds_.count(im)) {
                         // TODO:remove exist im
                         continue;
                     }
 
-                    auto entryIter = std::find_if(imEntries.cbegin(),
-                                                  imEntries.cend(),
-                                                  [&it](const InputMethodEntry &entry) {
-                                                      return entry.addonKey() == it->first
-                                                          && entry.uniqueName() == it->second;
-                                                  });
-                    if (entryIter == imEntries.cend()) {
+                    const auto *entry = this->dim()->findIMEntry(im);
+                    if (!entry) {
                         continue;
                     }
 
+                    trayIconIMIds_.emplace(im);
                     trayIconIMEntries_.append(new TrayIconInputMethodEntry{
-                        QString::fromStdString(entryIter->addonKey()),
-                        QString::fromStdString(entryIter->uniqueName()),
-                        QString::fromStdString(entryIter->description()),
-                        QString::fromStdString(entryIter->label()) });
+                        QString::fromStdString(entry->addonKey()),
+                        QString::fromStdString(entry->uniqueName()),
+                        QString::fromStdString(entry->description()),
+                        QString::fromStdString(entry->label()) });
                 }
 
                 updateTrayIconIMEntries();
@@ -86,7 +75,7 @@ TrayIcon::TrayIcon(Dim *dim)
 
 TrayIcon::~TrayIcon() { }
 
-void TrayIcon::onFocusedInputContextChanged(int focusedInputContext)
+void TrayIcon::onFocusedInputContextChanged(uint32_t focusedInputContext)
 {
     disconnect(oldConnection_);
 
@@ -100,21 +89,15 @@ void TrayIcon::onFocusedInputContextChanged(int focusedInputContext)
     }
 }
 
-void TrayIcon::onImSwitched(const std::pair<std::string, std::string> &imIndex)
+void TrayIcon::onImSwitched(InputMethodId im)
 {
-    const auto &imEntries = dim()->imEntries();
-    auto entryIter = std::find_if(imEntries.cbegin(),
-                                  imEntries.cend(),
-                                  [&imIndex](const InputMethodEntry &entry) {
-                                      return entry.addonKey() == imIndex.first
-                                          && entry.uniqueName() == imIndex.second;
-                                  });
-    if (entryIter == imEntries.cend()) {
-        qDebug() << "invalid input method" << QString::fromStdString(imIndex.second);
+    const auto *entry = dim()->findIMEntry(im);
+    if (!entry) {
+        qDebug() << "invalid input method" << QString::fromStdString(im.name());
         return;
     }
 
-    imAddonIcon_ = QString::fromStdString(entryIter->label());
+    imAddonIcon_ = QString::fromStdString(entry->label());
     qDebug() << "imAddonIcon" << imAddonIcon_;
     emit imAddonIconChanged(imAddonIcon_);
 }
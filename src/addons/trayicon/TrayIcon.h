@@ -6,10 +6,13 @@
 #define TRAYICON_TRAYICON_H
 
 #include <dimcore/FrontendAddon.h>
+#include <dimcore/InputMethodId.h>
 
 #include <QList>
 #include <QQmlApplicationEngine>
 
+#include <unordered_set>
+
 namespace org {
 namespace deepin {
 namespace dim {
@@ -81,10 +84,11 @@ private:
 
     QString imAddonIcon_;
     QList<TrayIconInputMethodEntry *> trayIconIMEntries_;
+    std::unordered_set<InputMethodId> trayIconIMIds_;
     QMetaObject::Connection oldConnection_;
 
-    void onFocusedInputContextChanged(int focusedInputContext);
-    void onImSwitched(const std::pair<std::string, std::string> &imIndex);
+    void onFocusedInputContextChanged(uint32_t focusedInputContext);
+    void onImSwitched(InputMethodId im);
 };
 
 } // namespace dim
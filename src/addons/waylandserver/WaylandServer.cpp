@@ -1,6 +1,7 @@
 #include "WaylandServer.h"
 
 #include "wl/client/Compositor.h"
+#include "dimcore/Tracer.h"
 #include "wl/client/ConnectionRaw.h"
 
 extern "C" {
@@ -41,6 +42,8 @@ WaylandServer::WaylandServer(Dim *dim)
     int fd = wl_event_loop_get_fd(loop);
 
     auto processWaylandEvents = [this, loop] {
+        DIM_TRACE_SCOPE("wayland", "WaylandServer::dispatch");
+
         int ret = wl_event_loop_dispatch(loop, 0);
         if (ret) {
             qWarning() << "wl_event_loop_dispatch error:" << ret;
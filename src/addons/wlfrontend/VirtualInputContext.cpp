@@ -33,6 +33,18 @@ void VirtualInputContext::commitStringImpl(const QString &text)
     parentIC_->commitStringDelegate(this, text);
 }
 
+void VirtualInputContext::updatePreeditImpl(std::string_view text,
+                                            int32_t cursorBegin,
+                                            int32_t cursorEnd)
+{
+    parentIC_->updatePreeditDelegate(this, text, cursorBegin, cursorEnd);
+}
+
+void VirtualInputContext::commitStringImpl(std::string_view text)
+{
+    parentIC_->commitStringDelegate(this, text);
+}
+
 void VirtualInputContext::commitImpl()
 {
     parentIC_->commitDelegate();
@@ -30,6 +30,8 @@ public:
 protected:
     void updatePreeditImpl(const QString &text, int32_t cursorBegin, int32_t cursorEnd) override;
     void commitStringImpl(const QString &text) override;
+    void updatePreeditImpl(std::string_view text, int32_t cursorBegin, int32_t cursorEnd) override;
+    void commitStringImpl(std::string_view text) override;
     void commitImpl() override;
     void forwardKeyImpl(uint32_t keycode, bool pressed) override;
 
@@ -53,7 +53,7 @@ void VirtualInputContextGlue::updateSurroundingTextWrapper()
 {
     updateSurroundingText();
     if (auto *ic = delegatedInputContext(); ic != this) {
-        ic->surroundingText() = surroundingText();
+        ic->surroundingText().update(surroundingText());
         ic->updateSurroundingText();
     }
 }
@@ -70,6 +70,18 @@ void VirtualInputContextGlue::commitStringImpl(const QString &text)
     commitStringDelegate(this, text);
 }
 
+void VirtualInputContextGlue::updatePreeditImpl(std::string_view text,
+                                                int32_t cursorBegin,
+                                                int32_t cursorEnd)
+{
+    updatePreeditDelegate(this, text, cursorBegin, cursorEnd);
+}
+
+void VirtualInputContextGlue::commitStringImpl(std::string_view text)
+{
+    commitStringDelegate(this, text);
+}
+
 void VirtualInputContextGlue::forwardKeyImpl(uint32_t keycode, bool pressed)
 {
     forwardKeyDelegate(this, keycode, pressed);
@@ -48,6 +48,8 @@ public:
 protected:
     void updatePreeditImpl(const QString &text, int32_t cursorBegin, int32_t cursorEnd) override;
     void commitStringImpl(const QString &text) override;
+    void updatePreeditImpl(std::string_view text, int32_t cursorBegin, int32_t cursorEnd) override;
+    void commitStringImpl(std::string_view text) override;
     void forwardKeyImpl(uint32_t keycode, bool pressed) override;
 
     virtual void updatePreeditDelegate(InputContext *ic,
@@ -55,6 +57,11 @@ protected:
                                        int32_t cursorBegin,
                                        int32_t cursorEnd) const = 0;
     virtual void commitStringDelegate(InputContext *, const QString &text) const = 0;
+    virtual void updatePreeditDelegate(InputContext *ic,
+                                       std::string_view text,
+                                       int32_t cursorBegin,
+                                       int32_t cursorEnd) const = 0;
+    virtual void commitStringDelegate(InputContext *, std::string_view text) const = 0;
     virtual void forwardKeyDelegate(InputContext *, uint32_t keycode, bool pressed) const = 0;
     virtual void commitDelegate() const = 0;
     virtual void deleteSurroundingTextDelegate(InputContext *ic,
@@ -8,24 +8,59 @@
 #include "VirtualInputContext.h"
 #include "VirtualInputContextGlue.h"
 #include "X11AppMonitor.h"
+#include "dimcore/Dconfig.h"
+#include "dimcore/Dim.h"
 #include "dimcore/InputContext.h"
 
-#include <experimental/unordered_map>
+#include <algorithm>
 
 using namespace org::deepin::dim;
 
+constexpr int DEFAULT_VIRTUAL_INPUT_CONTEXT_POOL_SIZE = 16;
+
+#ifdef Dtk6Core_FOUND
+const QString DimDConfigAppID = QStringLiteral("org.deepin.dde.dim");
+const QString DimDConfigJson = QStringLiteral("org.deepin.dde.dim");
+const QString KeyVirtualInputContextPoolSize = QStringLiteral("VirtualInputContextPoolSize");
+#endif
+
+void VirtualInputContextManager::VirtualInputContextDeleter::operator()(
+    VirtualInputContext *ic) const
+{
+    ic->destroy();
+}
+
 VirtualInputContextManager::VirtualInputContextManager(
     VirtualInputContextGlue *parentIC, const std::shared_ptr<AppMonitor> &appMonitor, Dim *dim)
     : dim_(dim)
     , parentIC_(parentIC)
     , appMonitor_(appMonitor)
 {
+    int poolSize = DEFAULT_VIRTUAL_INPUT_CONTEXT_POOL_SIZE;
+#ifdef Dtk6Core_FOUND
+    poolSize = DconfigSettings::ConfigValue(DimDConfigAppID,
+                                            DimDConfigJson,
+                                            KeyVirtualInputContextPoolSize,
+                                            DEFAULT_VIRTUAL_INPUT_CONTEXT_POOL_SIZE)
+                   .toInt();
+#endif
+    // the focused input context is always kept
+    capacity_ = std::max(poolSize, 1);
+
     parentIC_->setVirtualInputContextManager(this);
 
     connect(appMonitor_.get(), &AppMonitor::appUpdated, this, &VirtualInputContextManager::appUpdated);
 }
 
-VirtualInputContextManager::~VirtualInputContextManager() = default;
+VirtualInputContextManager::~VirtualInputContextManager()
+{
+    // the frontends may outlive Dim at shutdown, the input contexts must not be posted to it then
+    if (!dim_) {
+        for (auto &[_, ic] : pool_) {
+            delete ic.release();
+        }
+    }
+}
 
 void VirtualInputContextManager::setRealFocus(bool focus)
 {
@@ -39,15 +74,30 @@ VirtualInputContext *VirtualInputContextManager::focusedVirtualIC()
         return nullptr;
     }
 
-    return managed_.at(focus_).get();
+    auto iter = managed_.find(focus_);
+    if (iter == managed_.end()) {
+        return nullptr;
+    }
+
+    return iter->second->second.get();
 }
 
 void VirtualInputContextManager::appUpdated(const std::unordered_map<std::string, std::string> &appState,
                                             const std::string &focus)
 {
-    std::experimental::erase_if(managed_, [&appState](const auto &item) {
-        const auto &[key, pid] = item;
-        return appState.find(key) == appState.end();
+    for (auto iter = pool_.begin(); iter != pool_.end();) {
+        if (appState.find(iter->first) == appState.end()) {
+            if (iter->second.get() == focusedIC_) {
+                focusedIC_ = nullptr;
+            }
+            managed_.erase(iter->first);
+            iter = pool_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    evictedIMs_.remove_if([&appState](const auto &item) {
+        return appState.find(item.first) == appState.end();
     });
 
     lastAppState_ = appState;
@@ -66,14 +116,7 @@ void VirtualInputContextManager::updateFocus()
 {
     VirtualInputContext *ic = nullptr;
     if (!focus_.empty()) {
-        auto iter = managed_.find(focus_);
-        if (iter != managed_.end()) {
-            ic = iter->second.get();
-        } else {
-            auto result =
-                managed_.emplace(focus_, std::make_unique<VirtualInputContext>(parentIC_, dim_));
-            ic = result.first->second.get();
-        }
+        ic = getOrCreate(focus_);
     } else {
         ic = parentIC_;
     }
@@ -83,14 +126,60 @@ void VirtualInputContextManager::updateFocus()
         if (ic != parentIC_) {
             // ic->setCapabilityFlags(parentIC_->capabilityFlags());
             ic->setWindowPos(parentIC_->windowPos());
-            ic->surroundingText() = parentIC_->surroundingText();
+            ic->surroundingText().update(parentIC_->surroundingText());
             ic->updateSurroundingText();
         }
         ic->focusIn();
-    } else {
-        parentIC_->focusOut();
-        for (const auto &[_, ic] : managed_) {
-            ic->focusOut();
+        focusedIC_ = ic;
+    } else if (focusedIC_) {
+        // the others don't have the focus, their focus outs would count as transitions
+        focusedIC_->focusOut();
+        focusedIC_ = nullptr;
+    }
+
+    // evicted after the new input context took the focus
+    shrink();
+}
+
+VirtualInputContext *VirtualInputContextManager::getOrCreate(const std::string &key)
+{
+    auto iter = managed_.find(key);
+    if (iter != managed_.end()) {
+        pool_.splice(pool_.begin(), pool_, iter->second);
+        return iter->second->second.get();
+    }
+
+    pool_.emplace_front(key, VirtualInputContextPtr(new VirtualInputContext(parentIC_, dim_)));
+    managed_.emplace(key, pool_.begin());
+
+    auto *ic = pool_.front().second.get();
+
+    auto app = lastAppState_.find(key);
+    if (app != lastAppState_.end()) {
+        ic->setAppId(app->second);
+    }
+
+    // a rebuilt input context gets back the input method of the window
+    auto evicted = std::find_if(evictedIMs_.begin(), evictedIMs_.end(), [&key](const auto &item) {
+        return item.first == key;
+    });
+    if (evicted != evictedIMs_.end()) {
+        ic->inputState().restoreIM(evicted->second);
+        evictedIMs_.erase(evicted);
+    }
+
+    return ic;
+}
+
+void VirtualInputContextManager::shrink()
+{
+    while (pool_.size() > capacity_) {
+        auto &[key, ic] = pool_.back();
+        evictedIMs_.emplace_front(key, ic->inputState().currentIMEntry());
+        if (evictedIMs_.size() > capacity_) {
+            evictedIMs_.pop_back();
         }
+        managed_.erase(key);
+        pool_.pop_back();
     }
 }
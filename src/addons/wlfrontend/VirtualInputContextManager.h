@@ -5,9 +5,15 @@
 #ifndef VIRTUALINPUTCONTEXTMANAGER_H
 #define VIRTUALINPUTCONTEXTMANAGER_H
 
+#include "dimcore/InputMethodId.h"
+
 #include <QObject>
+#include <QPointer>
 
+#include <list>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 namespace org::deepin::dim {
 
@@ -28,16 +34,37 @@ public:
     VirtualInputContext *focusedVirtualIC();
 
 private:
-    Dim *dim_;
+    // destroys the input context through Dim
+    struct VirtualInputContextDeleter
+    {
+        void operator()(VirtualInputContext *ic) const;
+    };
+
+    using VirtualInputContextPtr = std::unique_ptr<VirtualInputContext, VirtualInputContextDeleter>;
+    // the input contexts of the windows, the most recently focused first
+    using PoolList = std::list<std::pair<std::string, VirtualInputContextPtr>>;
+
+    // cleared once Dim is destroyed, the input contexts are then deleted without telling it
+    QPointer<Dim> dim_;
     VirtualInputContextGlue *parentIC_;
     std::shared_ptr<AppMonitor> appMonitor_;
     std::unordered_map<std::string, std::string> lastAppState_;
-    std::unordered_map<std::string, std::unique_ptr<VirtualInputContext>> managed_;
+    // at most capacity_ input contexts are kept, the least recently focused one is evicted
+    size_t capacity_;
+    PoolList pool_;
+    std::unordered_map<std::string, PoolList::iterator> managed_;
+    // The input method of each evicted window, restored when its input context is rebuilt. The
+    // most recently evicted first, at most capacity_ are kept.
+    std::list<std::pair<std::string, InputMethodId>> evictedIMs_;
     std::string focus_;
+    // the input context which got the real focus, nullptr while there is none
+    VirtualInputContext *focusedIC_ = nullptr;
 
     void appUpdated(const std::unordered_map<std::string, std::string> &appState,
                     const std::string &focus);
     void updateFocus();
+    VirtualInputContext *getOrCreate(const std::string &key);
+    void shrink();
 };
 
 } // namespace org::deepin::dim
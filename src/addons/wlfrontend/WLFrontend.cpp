@@ -19,6 +19,7 @@
 #include "wl/client/ZwpVirtualKeyboardV1.h"
 
 #include <dimcore/Dim.h>
+#include <dimcore/Tracer.h>
 #include <qpa/qplatformnativeinterface.h>
 #include <wayland-client-core.h>
 #include <wayland-input-method-unstable-v2-client-protocol.h>
@@ -60,12 +61,14 @@ WLFrontend::WLFrontend(Dim *dim)
             }
             auto *notifier = new QSocketNotifier(wl->getFd(), QSocketNotifier::Read, this);
             connect(notifier, &QSocketNotifier::activated, this, [wl]() {
+                DIM_TRACE_SCOPE("wayland", "WLFrontend::dispatch");
                 wl->dispatch();
             });
 
             wl_ = wl;
             QAbstractEventDispatcher *dispatcher = QThread::currentThread()->eventDispatcher();
             QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, [this]() {
+                DIM_TRACE_SCOPE("wayland", "WLFrontend::flush");
                 wl_->flush();
             });
         }
@@ -9,6 +9,7 @@
 #include "VirtualInputContextManager.h"
 #include "common/common.h"
 #include "dimcore/Dim.h"
+#include "dimcore/EventRecorder.h"
 #include "wl/client/ZwpVirtualKeyboardV1.h"
 
 #include <linux/input.h>
@@ -69,12 +70,29 @@ void WaylandInputContext::updatePreeditDelegate(InputContext *ic,
                                                 int32_t cursorBegin,
                                                 int32_t cursorEnd) const
 {
-    im_->set_preedit_string(text.toStdString().c_str(), cursorBegin, cursorEnd);
+    toUtf8(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), utf8Buffer_);
+    im_->set_preedit_string(utf8Buffer_.c_str(), cursorBegin, cursorEnd);
 }
 
 void WaylandInputContext::commitStringDelegate(InputContext *, const QString &text) const
 {
-    im_->commit_string(text.toStdString().c_str());
+    toUtf8(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), utf8Buffer_);
+    im_->commit_string(utf8Buffer_.c_str());
+}
+
+void WaylandInputContext::updatePreeditDelegate(InputContext *ic,
+                                                std::string_view text,
+                                                int32_t cursorBegin,
+                                                int32_t cursorEnd) const
+{
+    utf8Buffer_.assign(text.data(), text.size());
+    im_->set_preedit_string(utf8Buffer_.c_str(), cursorBegin, cursorEnd);
+}
+
+void WaylandInputContext::commitStringDelegate(InputContext *, std::string_view text) const
+{
+    utf8Buffer_.assign(text.data(), text.size());
+    im_->commit_string(utf8Buffer_.c_str());
 }
 
 void WaylandInputContext::commitDelegate() const
@@ -110,11 +128,11 @@ void WaylandInputContext::surroundingTextCallback(const char *text,
                                                   uint32_t cursor,
                                                   uint32_t anchor)
 {
-    surroundingText().setText(text);
+    surroundingText().setText(text ? text : "");
     surroundingText().setCursor(cursor);
     surroundingText().setAnchor(anchor);
 
-    updateSurroundingTextWrapper();
+    pendingState_ |= PENDING_SURROUNDING_TEXT;
 }
 
 void WaylandInputContext::textChangeCauseCallback(uint32_t cause)
@@ -127,13 +145,26 @@ void WaylandInputContext::contentTypeCallback(uint32_t hint, uint32_t purpose)
     contentType().setHint(hint);
     contentType().setPurpose(purpose);
 
-    updateContentTypeWrapper();
+    pendingState_ |= PENDING_CONTENT_TYPE;
 }
 
 void WaylandInputContext::doneCallback()
 {
     serial_++;
 
+    // Clients may send the state several times before a done, only the final state is passed on,
+    // before the focus changes as the client sent it. The state is dropped with the focus.
+    if (pendingDeactivate_ && !pendingActivate_) {
+        pendingState_ = 0;
+    }
+    if (pendingState_ & PENDING_CONTENT_TYPE) {
+        updateContentTypeWrapper();
+    }
+    if (pendingState_ & PENDING_SURROUNDING_TEXT) {
+        updateSurroundingTextWrapper();
+    }
+    pendingState_ = 0;
+
     // TODO:
     if (pendingDeactivate_) {
         pendingDeactivate_ = false;
@@ -174,7 +205,10 @@ void WaylandInputContext::doneCallback()
         focusInWrapper();
     }
 
-    InputContextEvent event(EventType::InputContextDone, delegatedInputContext());
+    auto *ic = delegatedInputContext();
+    EventRecorder::record(EventRecorder::Done, ic->id());
+
+    InputContextEvent event(EventType::InputContextDone, ic);
     dim()->postEvent(event);
 }
 
@@ -274,6 +308,13 @@ void WaylandInputContext::modifiersCallback(uint32_t serial,
                                             uint32_t mods_locked,
                                             uint32_t group)
 {
+    EventRecorder::record(EventRecorder::Modifiers,
+                          delegatedInputContext()->id(),
+                          mods_depressed,
+                          mods_latched,
+                          mods_locked,
+                          group);
+
     if (xkbState_) {
         xkb_state_component comp = xkb_state_update_mask(xkbState_.get(),
                                                          mods_depressed,
@@ -56,6 +56,11 @@ protected:
                                int32_t cursorBegin,
                                int32_t cursorEnd) const override;
     void commitStringDelegate(InputContext *, const QString &text) const override;
+    void updatePreeditDelegate(InputContext *ic,
+                               std::string_view text,
+                               int32_t cursorBegin,
+                               int32_t cursorEnd) const override;
+    void commitStringDelegate(InputContext *, std::string_view text) const override;
     void forwardKeyDelegate(InputContext *, uint32_t keycode, bool pressed) const override;
     void commitDelegate() const override;
     void deleteSurroundingTextDelegate(InputContext *ic,
@@ -63,6 +68,12 @@ protected:
                                        unsigned int size) const override;
 
 private:
+    // state sent by the client, which is applied at the next done
+    enum PendingState : uint8_t {
+        PENDING_CONTENT_TYPE = 1 << 0,
+        PENDING_SURROUNDING_TEXT = 1 << 1,
+    };
+
     void activateCallback();
     void deactivateCallback();
     void surroundingTextCallback(const char *text, uint32_t cursor, uint32_t anchor);
@@ -91,6 +102,9 @@ private:
     uint32_t serial_ = 1;
     std::unique_ptr<State> state_;
 
+    // the NUL-terminated UTF-8 preedit and commit strings, reused to not allocate
+    mutable std::string utf8Buffer_;
+
     std::vector<char> keymapData_;
     std::unique_ptr<xkb_context, Deleter<xkb_context_unref>> xkbContext_;
     std::unique_ptr<xkb_keymap, Deleter<xkb_keymap_unref>> xkbKeymap_;
@@ -98,6 +112,7 @@ private:
 
     bool pendingDeactivate_ = false;
     bool pendingActivate_ = false;
+    uint8_t pendingState_ = 0;
 
     uint32_t modifierMask_[static_cast<uint8_t>(Modifiers::CNT)];
 };
@@ -5,6 +5,8 @@
 #ifndef COMMON_COMMON_H_
 #define COMMON_COMMON_H_
 
+#include <string>
+
 #include <stdint.h>
 #include <time.h>
 
@@ -78,4 +80,46 @@ static int32_t getTimestamp()
     return time.tv_sec * 1000 + time.tv_nsec / (1000 * 1000);
 }
 
+static uint64_t getMonotonicUs()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000 * 1000 + time.tv_nsec / 1000;
+}
+
+// Converts UTF-16 to UTF-8 into out, reusing its capacity so that converting on a hot path doesn't
+// allocate once out has grown. Unpaired surrogates become U+FFFD.
+inline void toUtf8(const char16_t *text, size_t length, std::string &out)
+{
+    out.clear();
+
+    for (size_t i = 0; i < length; i++) {
+        uint32_t c = text[i];
+
+        if (c >= 0xd800 && c <= 0xdfff) {
+            if (c <= 0xdbff && i + 1 < length && text[i + 1] >= 0xdc00 && text[i + 1] <= 0xdfff) {
+                c = 0x10000 + ((c - 0xd800) << 10) + (text[++i] - 0xdc00);
+            } else {
+                c = 0xfffd;
+            }
+        }
+
+        if (c < 0x80) {
+            out.push_back(char(c));
+        } else if (c < 0x800) {
+            out.push_back(char(0xc0 | (c >> 6)));
+            out.push_back(char(0x80 | (c & 0x3f)));
+        } else if (c < 0x10000) {
+            out.push_back(char(0xe0 | (c >> 12)));
+            out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(char(0x80 | (c & 0x3f)));
+        } else {
+            out.push_back(char(0xf0 | (c >> 18)));
+            out.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+            out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(char(0x80 | (c & 0x3f)));
+        }
+    }
+}
+
 #endif // COMMON_COMMON_H_
\ No newline at end of file
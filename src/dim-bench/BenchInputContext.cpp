@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "BenchInputContext.h"
+
+using namespace org::deepin::dim;
+
+BenchInputContext::BenchInputContext(Dim *dim)
+    : InputContext(dim)
+{
+}
+
+void BenchInputContext::updatePreeditImpl(const QString &text,
+                                          int32_t cursorBegin,
+                                          int32_t cursorEnd)
+{
+    preeditCount_++;
+}
+
+void BenchInputContext::commitStringImpl(const QString &text)
+{
+    commitStringCount_++;
+}
+
+void BenchInputContext::updatePreeditImpl(std::string_view text,
+                                          int32_t cursorBegin,
+                                          int32_t cursorEnd)
+{
+    preeditCount_++;
+}
+
+void BenchInputContext::commitStringImpl(std::string_view text)
+{
+    commitStringCount_++;
+}
+
+void BenchInputContext::commitImpl()
+{
+    commitCount_++;
+}
+
+void BenchInputContext::forwardKeyImpl(uint32_t keycode, bool pressed)
+{
+    forwardKeyCount_++;
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef BENCHINPUTCONTEXT_H
+#define BENCHINPUTCONTEXT_H
+
+#include <dimcore/InputContext.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Frontend input context of dim-bench, it only counts what the input method sends to the client
+class BenchInputContext : public InputContext
+{
+    Q_OBJECT
+
+public:
+    explicit BenchInputContext(Dim *dim);
+
+    uint64_t preeditCount() const { return preeditCount_; }
+
+    uint64_t commitStringCount() const { return commitStringCount_; }
+
+    uint64_t commitCount() const { return commitCount_; }
+
+    uint64_t forwardKeyCount() const { return forwardKeyCount_; }
+
+protected:
+    void updatePreeditImpl(const QString &text, int32_t cursorBegin, int32_t cursorEnd) override;
+    void commitStringImpl(const QString &text) override;
+    void updatePreeditImpl(std::string_view text, int32_t cursorBegin, int32_t cursorEnd) override;
+    void commitStringImpl(std::string_view text) override;
+    void commitImpl() override;
+    void forwardKeyImpl(uint32_t keycode, bool pressed) override;
+
+private:
+    uint64_t preeditCount_ = 0;
+    uint64_t commitStringCount_ = 0;
+    uint64_t commitCount_ = 0;
+    uint64_t forwardKeyCount_ = 0;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !BENCHINPUTCONTEXT_H
@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "EventStream.h"
+
+#include <dimcore/EventRecorder.h>
+
+#include <linux/input.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+using namespace org::deepin::dim;
+
+namespace {
+
+struct ScriptCommand
+{
+    const char *name;
+    BenchEvent::Type type;
+    int argCnt;
+};
+
+const ScriptCommand scriptCommands[] = {
+    { "focus_in", BenchEvent::FocusIn, 0 },
+    { "focus_out", BenchEvent::FocusOut, 0 },
+    { "key", BenchEvent::Key, 4 },
+    { "surrounding", BenchEvent::SurroundingText, 2 },
+    { "cursor_rect", BenchEvent::CursorRect, 4 },
+    { "content_type", BenchEvent::ContentType, 2 },
+    { "done", BenchEvent::Done, 0 },
+};
+
+// evdev keycodes of the letters a-z
+const uint32_t letterKeycodes[] = {
+    KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+    KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z,
+};
+
+bool parseArg(const QString &arg, uint32_t &value)
+{
+    bool ok;
+    value = arg.toUInt(&ok, 0);
+    return ok;
+}
+
+BenchEvent keyEvent(uint32_t keysym, uint32_t keycode, bool release)
+{
+    return BenchEvent{ BenchEvent::Key, { keysym, keycode, 0, release }, {} };
+}
+
+} // namespace
+
+const char *BenchEvent::typeName(Type type)
+{
+    for (const auto &command : scriptCommands) {
+        if (command.type == type) {
+            return command.name;
+        }
+    }
+
+    return "unknown";
+}
+
+bool org::deepin::dim::loadEventScript(const QString &path, std::vector<BenchEvent> &events)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "failed to open" << path;
+        return false;
+    }
+
+    QTextStream in(&file);
+    for (int lineNo = 1; !in.atEnd(); lineNo++) {
+        const QString line = in.readLine();
+        const QString content = line.left(line.indexOf('#')).trimmed();
+        if (content.isEmpty()) {
+            continue;
+        }
+
+        const QStringList words = content.split(' ', Qt::SkipEmptyParts);
+        const auto *command = std::find_if(std::begin(scriptCommands),
+                                           std::end(scriptCommands),
+                                           [&words](const ScriptCommand &command) {
+                                               return words[0] == command.name;
+                                           });
+        if (command == std::end(scriptCommands)) {
+            qWarning() << path << lineNo << ": unknown event" << words[0];
+            return false;
+        }
+
+        BenchEvent event{ command->type, {}, {} };
+
+        // the text of the surrounding text is the rest of the line
+        const int minWords = command->argCnt + 1;
+        if (words.size() < minWords
+            || (command->type != BenchEvent::SurroundingText && words.size() > minWords)) {
+            qWarning() << path << lineNo << ":" << words[0] << "takes" << command->argCnt
+                       << "arguments";
+            return false;
+        }
+
+        bool ok = true;
+        for (int i = 0; i < command->argCnt; i++) {
+            const QString &arg = words[i + 1];
+            if (command->type == BenchEvent::Key && i == 3) {
+                ok = arg == "press" || arg == "release";
+                event.args[i] = arg == "release";
+            } else {
+                ok = parseArg(arg, event.args[i]);
+            }
+
+            if (!ok) {
+                qWarning() << path << lineNo << ": invalid argument" << arg;
+                return false;
+            }
+        }
+
+        if (command->type == BenchEvent::SurroundingText) {
+            event.text = words.mid(minWords).join(' ').toUtf8();
+        }
+
+        events.emplace_back(std::move(event));
+    }
+
+    return true;
+}
+
+bool org::deepin::dim::loadEventLog(const QString &path, std::vector<BenchEvent> &events)
+{
+    std::vector<EventRecorder::Event> recorded;
+    if (!EventRecorder::load(path, recorded)) {
+        return false;
+    }
+
+    events.reserve(events.size() + recorded.size());
+    for (const auto &e : recorded) {
+        switch (e.type) {
+        case EventRecorder::FocusIn:
+            events.push_back(BenchEvent{ BenchEvent::FocusIn, {}, {} });
+            break;
+        case EventRecorder::FocusOut:
+            events.push_back(BenchEvent{ BenchEvent::FocusOut, {}, {} });
+            break;
+        case EventRecorder::Key:
+            events.push_back(
+                BenchEvent{ BenchEvent::Key, { e.args[0], e.args[1], e.args[2], e.args[3] }, {} });
+            break;
+        case EventRecorder::ContentType:
+            events.push_back(BenchEvent{ BenchEvent::ContentType, { e.args[0], e.args[1] }, {} });
+            break;
+        case EventRecorder::SurroundingText:
+            events.push_back(BenchEvent{ BenchEvent::SurroundingText,
+                                         { e.args[0], e.args[1] },
+                                         e.hasText ? e.text : QByteArray(e.textLength, 'x') });
+            break;
+        case EventRecorder::Done:
+            events.push_back(BenchEvent{ BenchEvent::Done, {}, {} });
+            break;
+        default:
+            // the modifiers are carried by the key events
+            break;
+        }
+    }
+
+    return true;
+}
+
+std::vector<BenchEvent> org::deepin::dim::syntheticEventStream(size_t keys)
+{
+    std::vector<BenchEvent> events;
+    events.reserve(keys * 3 + 5);
+
+    events.push_back(BenchEvent{ BenchEvent::FocusIn, {}, {} });
+    events.push_back(BenchEvent{ BenchEvent::SurroundingText, { 0, 0 }, {} });
+    events.push_back(BenchEvent{ BenchEvent::Done, {}, {} });
+
+    // a space after every 6 letters, the typing moves the cursor rectangle
+    for (size_t i = 0; i < keys; i++) {
+        uint32_t keysym = ' ';
+        uint32_t keycode = KEY_SPACE;
+        if (i % 7 != 6) {
+            const uint32_t letter = (i * 7) % 26;
+            keysym = 'a' + letter;
+            keycode = letterKeycodes[letter];
+        }
+
+        events.push_back(keyEvent(keysym, keycode, false));
+        events.push_back(keyEvent(keysym, keycode, true));
+        events.push_back(BenchEvent{ BenchEvent::CursorRect, { uint32_t(i % 80) * 8, 0, 1, 16 }, {} });
+    }
+
+    events.push_back(BenchEvent{ BenchEvent::FocusOut, {}, {} });
+    events.push_back(BenchEvent{ BenchEvent::Done, {}, {} });
+
+    return events;
+}
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef EVENTSTREAM_H
+#define EVENTSTREAM_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// An event a frontend passes to an input context
+struct BenchEvent
+{
+    enum Type : uint8_t {
+        FocusIn,
+        FocusOut,
+        Key, // args: keysym, keycode, modifiers, release
+        SurroundingText, // args: cursor, anchor
+        CursorRect, // args: x, y, w, h
+        ContentType, // args: hint, purpose
+        Done,
+
+        TYPE_CNT,
+    };
+
+    Type type;
+    uint32_t args[4];
+    QByteArray text; // UTF-8
+
+    static const char *typeName(Type type);
+};
+
+// Loads a stream from a script with one event per line, '#' starts a comment:
+//
+//   focus_in
+//   focus_out
+//   key <keysym> <keycode> <modifiers> press|release
+//   surrounding <cursor> <anchor> <text>
+//   cursor_rect <x> <y> <w> <h>
+//   content_type <hint> <purpose>
+//   done
+//
+// Numbers may be written in hex with a 0x prefix, keycodes are evdev keycodes. The cursor and the
+// anchor of the surrounding text are byte offsets in its UTF-8 text.
+bool loadEventScript(const QString &path, std::vector<BenchEvent> &events);
+
+// Loads a log written by EventRecorder, i.e. recorded with DIM_RECORD. The events of all input
+// contexts are replayed on one. Texts which were not recorded are replaced with placeholders of
+// the same length.
+bool loadEventLog(const QString &path, std::vector<BenchEvent> &events);
+
+// An input context which is focused, gets `keys` letters and spaces typed and is unfocused
+std::vector<BenchEvent> syntheticEventStream(size_t keys);
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !EVENTSTREAM_H
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "LoopbackAddon.h"
+
+#include <dimcore/InputContext.h>
+
+using namespace org::deepin::dim;
+
+LoopbackAddon::LoopbackAddon(Dim *dim)
+    : InputMethodAddon(dim, "loopback", "input-keyboard")
+{
+}
+
+LoopbackAddon::~LoopbackAddon() = default;
+
+const QList<InputMethodEntry> &LoopbackAddon::getInputMethods()
+{
+    return entries_;
+}
+
+void LoopbackAddon::initInputMethods()
+{
+    entries_.clear();
+    entries_.append(InputMethodEntry(key(), "echo", "Echo", "Commits the keys as typed", "E", ""));
+
+    Q_EMIT addonInitFinished(this);
+}
+
+bool LoopbackAddon::keyEvent(const InputMethodEntry &entry, InputContextKeyEvent &keyEvent)
+{
+    if (keyEvent.isRelease()) {
+        return false;
+    }
+
+    // Latin-1 keysyms are their code points
+    const uint32_t sym = keyEvent.keySym();
+    if ((sym < 0x20 || sym > 0x7e) && (sym < 0xa0 || sym > 0xff)) {
+        return false;
+    }
+
+    // Latin-1 to UTF-8
+    char text[2];
+    size_t length = 1;
+    if (sym < 0x80) {
+        text[0] = sym;
+    } else {
+        text[0] = 0xc0 | (sym >> 6);
+        text[1] = 0x80 | (sym & 0x3f);
+        length = 2;
+    }
+
+    auto *ic = keyEvent.ic();
+    ic->commitString(std::string_view(text, length));
+    ic->commit();
+
+    return true;
+}
+
+void LoopbackAddon::updateSurroundingText(InputContextEvent &event) { }
+
+void LoopbackAddon::setCurrentIM(const std::string &im) { }
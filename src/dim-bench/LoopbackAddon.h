@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LOOPBACKADDON_H
+#define LOOPBACKADDON_H
+
+#include <dimcore/InputMethodAddon.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Input method of dim-bench which commits the printable keys as they are, so that a benchmark
+// measures dim itself and not an input method engine
+class LoopbackAddon : public InputMethodAddon
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackAddon(Dim *dim);
+    ~LoopbackAddon() override;
+
+    const QList<InputMethodEntry> &getInputMethods() override;
+    void initInputMethods() override;
+    bool keyEvent(const InputMethodEntry &entry, InputContextKeyEvent &keyEvent) override;
+    void updateSurroundingText(InputContextEvent &event) override;
+    void setCurrentIM(const std::string &im) override;
+
+private:
+    QList<InputMethodEntry> entries_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !LOOPBACKADDON_H
@@ -0,0 +1,322 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// dim-bench replays streams of frontend events through a headless Dim, without Wayland and D-Bus,
+// and reports the throughput, the latency and the heap allocations of each kind of event.
+
+#include "BenchInputContext.h"
+#include "EventStream.h"
+#include "LoopbackAddon.h"
+
+#include <dimcore/Dim.h>
+#include <dimcore/LatencyHistogram.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#include <dlfcn.h>
+#include <errno.h>
+
+using namespace org::deepin::dim;
+
+// Every heap allocation of the process, dimcore, Qt and the addons included, goes through the
+// malloc() family defined here, operator new calls malloc() as well
+static std::atomic<uint64_t> allocationCount{ 0 };
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) noexcept
+{
+    void *p = memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+
+    *ptr = p;
+    return 0;
+}
+
+void free(void *ptr) noexcept
+{
+    __libc_free(ptr);
+}
+}
+
+namespace {
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct EventStats
+{
+    LatencyHistogram latencyNs;
+    uint64_t allocations = 0;
+};
+
+void replayEvent(Dim *dim, BenchInputContext *ic, const BenchEvent &event, uint32_t time)
+{
+    switch (event.type) {
+    case BenchEvent::FocusIn:
+        ic->focusIn();
+        break;
+    case BenchEvent::FocusOut:
+        ic->focusOut();
+        break;
+    case BenchEvent::Key: {
+        InputContextKeyEvent e(ic,
+                               event.args[0],
+                               event.args[1],
+                               event.args[2],
+                               event.args[3],
+                               time);
+        ic->keyEvent(e);
+        break;
+    }
+    case BenchEvent::SurroundingText:
+        ic->surroundingText().setText(
+            std::string_view(event.text.constData(), event.text.size()));
+        ic->surroundingText().setCursor(event.args[0]);
+        ic->surroundingText().setAnchor(event.args[1]);
+        ic->updateSurroundingText();
+        break;
+    case BenchEvent::CursorRect: {
+        InputContextCursorRectChangeEvent e(ic,
+                                            event.args[0],
+                                            event.args[1],
+                                            event.args[2],
+                                            event.args[3]);
+        dim->postEvent(e);
+        break;
+    }
+    case BenchEvent::ContentType:
+        ic->contentType().setHint(event.args[0]);
+        ic->contentType().setPurpose(event.args[1]);
+        ic->updateContentType();
+        break;
+    case BenchEvent::Done: {
+        InputContextEvent e(EventType::InputContextDone, ic);
+        dim->postEvent(e);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool loadAddonModule(Dim *dim, const QString &path)
+{
+    void *handle = dlopen(path.toLocal8Bit().constData(), RTLD_NOW);
+    if (!handle) {
+        qWarning() << "failed to load addon" << path << dlerror();
+        return false;
+    }
+
+    auto *create = reinterpret_cast<addonCreate *>(dlsym(handle, "create"));
+    if (!create) {
+        qWarning() << "addon" << path << "has no create()";
+        return false;
+    }
+
+    return dim->registerAddon(create(dim), AddonType::InputMethod);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays frontend events through dimcore");
+    parser.addHelpOption();
+    QCommandLineOption scriptOption("script", "Replay the events of <file>.", "file");
+    QCommandLineOption replayOption("replay",
+                                    "Replay the events of the log <file> written with DIM_RECORD.",
+                                    "file");
+    QCommandLineOption syntheticOption("synthetic",
+                                       "Replay <keys> synthetic key presses (default).",
+                                       "keys",
+                                       "10000");
+    QCommandLineOption addonOption("addon",
+                                   "Load the input method addon module <path>, e.g. keyboard.so.",
+                                   "path");
+    QCommandLineOption imOption("im",
+                                "Type with the input method <addon:name>.",
+                                "im",
+                                "loopback:echo");
+    QCommandLineOption iterationsOption("iterations",
+                                        "Replay the stream <n> times.",
+                                        "n",
+                                        "10");
+    QCommandLineOption warmupOption("warmup",
+                                    "Replay the stream <n> times before measuring.",
+                                    "n",
+                                    "1");
+    QCommandLineOption checkAllocationsOption(
+        "check-allocations",
+        "Fail if a measured key event allocates on the heap, for regression checks.");
+    parser.addOptions({ scriptOption,
+                        replayOption,
+                        syntheticOption,
+                        addonOption,
+                        imOption,
+                        iterationsOption,
+                        warmupOption,
+                        checkAllocationsOption });
+    parser.process(app);
+
+    std::vector<BenchEvent> events;
+    if (parser.isSet(scriptOption)) {
+        if (!loadEventScript(parser.value(scriptOption), events)) {
+            return 1;
+        }
+    } else if (parser.isSet(replayOption)) {
+        if (!loadEventLog(parser.value(replayOption), events)) {
+            return 1;
+        }
+    } else {
+        events = syntheticEventStream(parser.value(syntheticOption).toUInt());
+    }
+
+    Dim dim(nullptr, true);
+    dim.registerAddon(new LoopbackAddon(&dim), AddonType::InputMethod);
+    for (const auto &path : parser.values(addonOption)) {
+        if (!loadAddonModule(&dim, path)) {
+            return 1;
+        }
+    }
+
+    const InputMethodId im = InputMethodId::fromKey(parser.value(imOption));
+    if (!dim.findIMEntry(im)) {
+        qWarning() << "no input method" << parser.value(imOption);
+        return 1;
+    }
+    dim.addInputMethod(im.addon(), im.name());
+
+    auto *ic = new BenchInputContext(&dim);
+    // deliver the queued inputMethodEntryChanged before switching
+    app.processEvents();
+    ic->inputState().requestSwitchIM(im);
+
+    const uint32_t warmup = parser.value(warmupOption).toUInt();
+    const uint32_t iterations = parser.value(iterationsOption).toUInt();
+    std::array<EventStats, BenchEvent::TYPE_CNT> stats;
+    uint64_t totalNs = 0;
+    uint32_t time = 0;
+
+    for (uint32_t i = 0; i < warmup + iterations; i++) {
+        const bool measure = i >= warmup;
+        if (i == warmup) {
+            dim.resetFocusTransitionStats();
+        }
+
+        for (const auto &event : events) {
+            const uint64_t allocations = allocationCount.load(std::memory_order_relaxed);
+            const uint64_t begin = nowNs();
+
+            replayEvent(&dim, ic, event, time++);
+
+            const uint64_t elapsed = nowNs() - begin;
+            if (measure) {
+                stats[event.type].latencyNs.record(elapsed);
+                stats[event.type].allocations +=
+                    allocationCount.load(std::memory_order_relaxed) - allocations;
+                totalNs += elapsed;
+            }
+        }
+
+        // timers started by the events, e.g. the input method switch shortcut
+        app.processEvents();
+    }
+
+    const uint64_t eventCount = uint64_t(events.size()) * iterations;
+    std::printf("%llu events in %.3f ms, %.0f events/s\n",
+                static_cast<unsigned long long>(eventCount),
+                totalNs / 1e6,
+                totalNs ? eventCount * 1e9 / totalNs : 0.0);
+    std::printf("%-14s %10s %10s %10s %10s %12s\n",
+                "event",
+                "count",
+                "p50 ns",
+                "p99 ns",
+                "max ns",
+                "allocs/event");
+    for (int type = 0; type < BenchEvent::TYPE_CNT; type++) {
+        const auto snapshot = stats[type].latencyNs.snapshot();
+        if (!snapshot.count) {
+            continue;
+        }
+
+        std::printf("%-14s %10llu %10llu %10llu %10llu %12.2f\n",
+                    BenchEvent::typeName(static_cast<BenchEvent::Type>(type)),
+                    static_cast<unsigned long long>(snapshot.count),
+                    static_cast<unsigned long long>(snapshot.p50),
+                    static_cast<unsigned long long>(snapshot.p99),
+                    static_cast<unsigned long long>(snapshot.max),
+                    double(stats[type].allocations) / snapshot.count);
+    }
+    std::printf("%llu commits, %llu forwarded keys\n",
+                static_cast<unsigned long long>(ic->commitCount()),
+                static_cast<unsigned long long>(ic->forwardKeyCount()));
+    std::printf("%llu focus transitions, %llu suppressed\n",
+                static_cast<unsigned long long>(dim.focusTransitions()),
+                static_cast<unsigned long long>(dim.suppressedFocusTransitions()));
+
+    // the warmup has grown the caches and buffers, a steady-state key event must not allocate
+    const auto &keyStats = stats[BenchEvent::Key];
+    if (parser.isSet(checkAllocationsOption) && keyStats.allocations) {
+        std::fprintf(stderr,
+                     "FAIL: %llu heap allocations in %llu key events\n",
+                     static_cast<unsigned long long>(keyStats.allocations),
+                     static_cast<unsigned long long>(keyStats.latencyNs.snapshot().count));
+        return 1;
+    }
+
+    return 0;
+}
@@ -5,6 +5,15 @@
 #include "DimDBusAdaptor.h"
 
 #include "dbus/DimDBusType.h"
+#include "dimcore/InputMethodAddon.h"
+#include "dimcore/Tracer.h"
+
+static const char *const KeyLatencyStageNames[InputMethodAddon::KEY_LATENCY_STAGE_CNT] = {
+    "dispatch",
+    "addon",
+    "engine",
+    "total",
+};
 
 DimDBusAdaptor::DimDBusAdaptor(Dim *parent)
     : QObject(parent)
@@ -41,15 +50,14 @@ bool DimDBusAdaptor::SetCurrentInputMethod(const QString &addon, const QString &
 
 InputMethodData DimDBusAdaptor::GetCurrentInputMethod()
 {
-    const auto imKey = parent()->getCurrentActiveInputMethod();
-    return InputMethodData{ QString::fromStdString(imKey.first),
-                            QString::fromStdString(imKey.second) };
+    const auto im = parent()->getCurrentActiveInputMethod();
+    return InputMethodData{ QString::fromStdString(im.addon()), QString::fromStdString(im.name()) };
 }
 
 InputMethodEntryList DimDBusAdaptor::GetAvailableInputMethods()
 {
     InputMethodEntryList availableInputMethods = InputMethodEntryList{};
-    for (const auto &entry : parent()->imEntries()) {
+    for (const auto &entry : parent()->availableIMEntries()) {
         availableInputMethods.append(
             ::InputMethodEntry{ QString::fromStdString(entry.addonKey()),
                                 QString::fromStdString(entry.uniqueName()),
@@ -67,7 +75,7 @@ InputMethodDataList DimDBusAdaptor::GetCurrentInputMethods()
     InputMethodDataList currentActiveIMs = InputMethodDataList{};
     for (const auto &im : parent()->activeInputMethodEntries()) {
         currentActiveIMs.append(
-            InputMethodData{ QString::fromStdString(im.first), QString::fromStdString(im.second) });
+            InputMethodData{ QString::fromStdString(im.addon()), QString::fromStdString(im.name()) });
     }
 
     return currentActiveIMs;
@@ -101,3 +109,65 @@ void DimDBusAdaptor::Toggle()
 {
     parent()->toggle();
 }
+
+KeyLatencyStatList DimDBusAdaptor::GetKeyLatencyStats()
+{
+    KeyLatencyStatList stats;
+    for (const auto &[key, addon] : parent()->addons()) {
+        auto *imAddon = qobject_cast<InputMethodAddon *>(addon);
+        if (!imAddon) {
+            continue;
+        }
+
+        for (int i = 0; i < InputMethodAddon::KEY_LATENCY_STAGE_CNT; i++) {
+            const auto stage = static_cast<InputMethodAddon::KeyLatencyStage>(i);
+            const auto snapshot = imAddon->keyLatency(stage).snapshot();
+            stats.append(KeyLatencyStat{ QString::fromStdString(key),
+                                         KeyLatencyStageNames[i],
+                                         snapshot.count,
+                                         snapshot.p50,
+                                         snapshot.p99,
+                                         snapshot.max });
+        }
+    }
+
+    return stats;
+}
+
+void DimDBusAdaptor::ResetKeyLatencyStats()
+{
+    for (const auto &[key, addon] : parent()->addons()) {
+        auto *imAddon = qobject_cast<InputMethodAddon *>(addon);
+        if (!imAddon) {
+            continue;
+        }
+
+        for (int i = 0; i < InputMethodAddon::KEY_LATENCY_STAGE_CNT; i++) {
+            imAddon->keyLatency(static_cast<InputMethodAddon::KeyLatencyStage>(i)).reset();
+        }
+    }
+}
+
+qulonglong DimDBusAdaptor::GetFocusTransitionStats(qulonglong &suppressed)
+{
+    suppressed = parent()->suppressedFocusTransitions();
+
+    return parent()->focusTransitions();
+}
+
+void DimDBusAdaptor::ResetFocusTransitionStats()
+{
+    parent()->resetFocusTransitionStats();
+}
+
+void DimDBusAdaptor::StartTrace()
+{
+    Tracer::start();
+}
+
+bool DimDBusAdaptor::StopTrace(const QString &path)
+{
+    Tracer::stop();
+
+    return Tracer::dump(path);
+}
@@ -43,6 +43,12 @@ public Q_SLOTS:
     QDBusVariant GetConfig(const QString &addon, const QString &name);
     void SetConfig(const QString &addon, const QString &name, const QDBusVariant &config);
     void Toggle();
+    KeyLatencyStatList GetKeyLatencyStats();
+    void ResetKeyLatencyStats();
+    qulonglong GetFocusTransitionStats(qulonglong &suppressed);
+    void ResetFocusTransitionStats();
+    void StartTrace();
+    bool StopTrace(const QString &path);
 
 signals:
     // signals on dbus
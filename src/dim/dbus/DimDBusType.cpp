@@ -13,6 +13,8 @@ void registerDimQtDBusTypes()
     qRegisterMetaType<InputMethodConfigList>("InputMethodConfigList");
     qRegisterMetaType<InputMethodEntry>("InputMethodEntry");
     qRegisterMetaType<InputMethodEntryList>("InputMethodEntryList");
+    qRegisterMetaType<KeyLatencyStat>("KeyLatencyStat");
+    qRegisterMetaType<KeyLatencyStatList>("KeyLatencyStatList");
 
     qDBusRegisterMetaType<InputMethodData>();
     qDBusRegisterMetaType<InputMethodDataList>();
@@ -21,6 +23,8 @@ void registerDimQtDBusTypes()
     qDBusRegisterMetaType<InputMethodConfigList>();
     qDBusRegisterMetaType<InputMethodEntry>();
     qDBusRegisterMetaType<InputMethodEntryList>();
+    qDBusRegisterMetaType<KeyLatencyStat>();
+    qDBusRegisterMetaType<KeyLatencyStatList>();
 }
 
 QDBusArgument &operator<<(QDBusArgument &argument, const InputMethodData &data)
@@ -108,3 +112,21 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, InputMethodEntry
 
     return argument;
 }
+
+QDBusArgument &operator<<(QDBusArgument &argument, const KeyLatencyStat &data)
+{
+    argument.beginStructure();
+    argument << data.addon << data.stage << data.count << data.p50 << data.p99 << data.max;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, KeyLatencyStat &data)
+{
+    argument.beginStructure();
+    argument >> data.addon >> data.stage >> data.count >> data.p50 >> data.p99 >> data.max;
+    argument.endStructure();
+
+    return argument;
+}
@@ -40,9 +40,21 @@ struct InputMethodEntry {
     QString iconName;
 };
 
+// latency of a key event stage of an input method addon, in microseconds
+struct KeyLatencyStat
+{
+    QString addon;
+    QString stage;
+    quint64 count;
+    quint64 p50;
+    quint64 p99;
+    quint64 max;
+};
+
 typedef QList<InputMethodData> InputMethodDataList;
 typedef QList<Config> InputMethodConfigList;
 typedef QList<InputMethodEntry> InputMethodEntryList;
+typedef QList<KeyLatencyStat> KeyLatencyStatList;
 
 void registerDimQtDBusTypes();
 
@@ -54,6 +66,8 @@ QDBusArgument &operator<<(QDBusArgument &argument, const ConfigOption &data);
 const QDBusArgument &operator>>(const QDBusArgument &argument, ConfigOption &data);
 QDBusArgument &operator<<(QDBusArgument &argument, const InputMethodEntry &data);
 const QDBusArgument &operator>>(const QDBusArgument &argument, InputMethodEntry &data);
+QDBusArgument &operator<<(QDBusArgument &argument, const KeyLatencyStat &data);
+const QDBusArgument &operator>>(const QDBusArgument &argument, KeyLatencyStat &data);
 
 Q_DECLARE_METATYPE(InputMethodData)
 Q_DECLARE_METATYPE(InputMethodDataList)
@@ -62,5 +76,7 @@ Q_DECLARE_METATYPE(ConfigOption)
 Q_DECLARE_METATYPE(InputMethodConfigList)
 Q_DECLARE_METATYPE(InputMethodEntry)
 Q_DECLARE_METATYPE(InputMethodEntryList)
+Q_DECLARE_METATYPE(KeyLatencyStat)
+Q_DECLARE_METATYPE(KeyLatencyStatList)
 
 #endif // DIM_DBUS_TYPE_H
@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "AppInputStateCache.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace org::deepin::dim;
+
+static const char STATE_MAGIC[8] = { 'D', 'I', 'M', 'A', 'P', 'P', 'S', '\0' };
+constexpr uint32_t STATE_VERSION = 1;
+
+namespace {
+
+struct StateHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    // incremented on every use, the record with the smallest lastUsed is dropped first
+    uint32_t clock;
+    uint32_t reserved;
+};
+
+struct StateRecord
+{
+    // 0 if the record is free
+    uint64_t appHash;
+    uint32_t lastUsed;
+    // NUL-terminated "addon:name"
+    char im[52];
+};
+
+static_assert(sizeof(StateRecord) == 64, "records are a cache line");
+
+constexpr size_t STATE_FILE_SIZE =
+    sizeof(StateHeader) + AppInputStateCache::CAPACITY * sizeof(StateRecord);
+
+StateHeader *header(char *data)
+{
+    return reinterpret_cast<StateHeader *>(data);
+}
+
+StateRecord *records(char *data)
+{
+    return reinterpret_cast<StateRecord *>(data + sizeof(StateHeader));
+}
+
+uint64_t appHash(std::string_view appId)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    for (unsigned char c : appId) {
+        hash = (hash ^ c) * 0x100000001b3;
+    }
+
+    // 0 marks a free record
+    return hash ? hash : 1;
+}
+
+} // namespace
+
+AppInputStateCache::~AppInputStateCache()
+{
+    close();
+}
+
+void AppInputStateCache::open(const QString &path)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0
+            && (st.st_size == static_cast<off_t>(STATE_FILE_SIZE)
+                || ftruncate(fd, STATE_FILE_SIZE) == 0)) {
+            void *data =
+                mmap(nullptr, STATE_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<char *>(data);
+                mapped_ = true;
+            }
+        }
+        ::close(fd);
+    }
+
+    if (!mapped_) {
+        qWarning() << "failed to map application input states" << path;
+        buffer_.assign(STATE_FILE_SIZE, 0);
+        data_ = buffer_.data();
+    }
+
+    const auto *h = header(data_);
+    if (memcmp(h->magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0 || h->version != STATE_VERSION
+        || h->capacity != CAPACITY) {
+        reset();
+    }
+
+    auto *recs = records(data_);
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        auto &record = recs[i];
+        if (!record.appHash) {
+            continue;
+        }
+
+        // written by an older process which died in the middle of a store
+        if (!memchr(record.im, '\0', sizeof(record.im))) {
+            record = {};
+            continue;
+        }
+
+        index_.emplace(record.appHash, i);
+    }
+}
+
+InputMethodId AppInputStateCache::find(std::string_view appId)
+{
+    if (!data_) {
+        return InputMethodId();
+    }
+
+    auto iter = index_.find(appHash(appId));
+    if (iter == index_.end()) {
+        return InputMethodId();
+    }
+
+    auto &record = records(data_)[iter->second];
+    record.lastUsed = ++header(data_)->clock;
+
+    return InputMethodId::fromKey(QString::fromUtf8(record.im));
+}
+
+void AppInputStateCache::store(std::string_view appId, InputMethodId im)
+{
+    if (!data_ || !im.isValid()) {
+        return;
+    }
+
+    const QByteArray key = im.toKey().toUtf8();
+    auto *recs = records(data_);
+    if (static_cast<size_t>(key.size()) >= sizeof(recs[0].im)) {
+        return;
+    }
+
+    const uint64_t hash = appHash(appId);
+    auto iter = index_.find(hash);
+
+    uint32_t slot;
+    if (iter != index_.end()) {
+        slot = iter->second;
+    } else {
+        // a free record, or the least recently used one
+        slot = 0;
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            if (!recs[i].appHash) {
+                slot = i;
+                break;
+            }
+            if (recs[i].lastUsed < recs[slot].lastUsed) {
+                slot = i;
+            }
+        }
+
+        if (recs[slot].appHash) {
+            index_.erase(recs[slot].appHash);
+        }
+        index_.emplace(hash, slot);
+    }
+
+    auto &record = recs[slot];
+    record.appHash = hash;
+    record.lastUsed = ++header(data_)->clock;
+    memset(record.im, 0, sizeof(record.im));
+    memcpy(record.im, key.constData(), key.size());
+}
+
+void AppInputStateCache::close()
+{
+    if (mapped_) {
+        munmap(data_, STATE_FILE_SIZE);
+    }
+
+    data_ = nullptr;
+    mapped_ = false;
+    buffer_.clear();
+    index_.clear();
+}
+
+void AppInputStateCache::reset()
+{
+    memset(data_, 0, STATE_FILE_SIZE);
+
+    auto *h = header(data_);
+    memcpy(h->magic, STATE_MAGIC, sizeof(h->magic));
+    h->version = STATE_VERSION;
+    h->capacity = CAPACITY;
+}
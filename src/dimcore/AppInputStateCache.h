@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef APPINPUTSTATECACHE_H
+#define APPINPUTSTATECACHE_H
+
+#include "InputMethodId.h"
+
+#include <QString>
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// The input method last used by each application, for ShareInputState "per program".
+//
+// The states are kept in a small fixed-size file which is memory-mapped shared, so an update is
+// a store into the mapping and the states survive a restart without an explicit save. Only a
+// hash of the application id is written. When the file is full the least recently used
+// application is dropped.
+class AppInputStateCache
+{
+public:
+    static constexpr uint32_t CAPACITY = 256;
+
+    AppInputStateCache() = default;
+    ~AppInputStateCache();
+
+    AppInputStateCache(const AppInputStateCache &) = delete;
+    AppInputStateCache &operator=(const AppInputStateCache &) = delete;
+
+    // Maps the file at path, creating it if it is missing or invalid. The states are kept in
+    // memory if the file can't be mapped.
+    void open(const QString &path);
+    bool isOpen() const { return data_ != nullptr; }
+
+    // invalid if the application has no state
+    InputMethodId find(std::string_view appId);
+    void store(std::string_view appId, InputMethodId im);
+
+private:
+    void close();
+    void reset();
+
+private:
+    char *data_ = nullptr;
+    bool mapped_ = false;
+    // holds the states when the file could not be mapped
+    std::vector<char> buffer_;
+    // application hash -> record
+    std::unordered_map<uint64_t, uint32_t> index_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !APPINPUTSTATECACHE_H
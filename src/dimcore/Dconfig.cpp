@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "Dconfig.h"
+#include "Tracer.h"
 
 #include <QDebug>
 #include <QSharedPointer>
@@ -52,6 +53,8 @@ bool DconfigSettings::ConfigSaveValue(const QString &appId,
                                       const QString &key,
                                       const QVariant &value)
 {
+    DIM_TRACE_SCOPE("dconfig", "ConfigSaveValue");
+
     QScopedPointer<DConfig> config(ConfigPtr(appId, name));
     if (config && config->isValid() && config->keyList().contains(key)) {
         config->setValue(key, value);
@@ -6,10 +6,12 @@
 
 #include "Addon.h"
 #include "Dconfig.h"
+#include "EventRecorder.h"
 #include "FrontendAddon.h"
 #include "InputContext.h"
 #include "InputMethodAddon.h"
 #include "ProxyAddon.h"
+#include "Tracer.h"
 #include "common/common.h"
 #include "config.h"
 
@@ -17,6 +19,7 @@
 #include <QDir>
 #include <QPluginLoader>
 #include <QSettings>
+#include <QStandardPaths>
 #include <QTimer>
 
 #define XK_MISCELLANY
@@ -25,8 +28,20 @@
 
 #include <dlfcn.h>
 
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
 constexpr uint32_t DIM_INPUT_METHOD_SWITCH_KEYBINDING_CODE = SHIFT_MASK | CONTROL_MASK;
-const auto &defaultLoadedIM = std::make_pair("keyboard", "us");
+
+// 0 delivers a focus out on the next event loop iteration
+constexpr int DEFAULT_FOCUS_OUT_DELAY = 0;
+// milliseconds a proxy engine has to answer a key press, 0 doesn't hold keys back behind it
+constexpr int DEFAULT_ENGINE_RESPONSE_TIMEOUT = 50;
+// minutes after which an unused engine daemon is stopped, 0 keeps it running
+constexpr int DEFAULT_DAEMON_IDLE_TIMEOUT = 0;
+constexpr int DAEMON_IDLE_CHECK_INTERVAL = 60000;
 
 #ifdef Dtk6Core_FOUND
 const QString DimDConfigAppID = QStringLiteral("org.deepin.dde.dim");
@@ -34,10 +49,18 @@ const QString DimDConfigJson = QStringLiteral("org.deepin.dde.dim");
 const QString ShareInputState = QStringLiteral("ShareInputState");
 const QString KeyCurrentInputSource = QStringLiteral("CurrentInputSource");
 const QString KeyCurrentUserInputSources = QStringLiteral("CurrentUserInputSources");
+const QString KeyFocusOutDelay = QStringLiteral("FocusOutDelay");
+const QString KeyEngineResponseTimeout = QStringLiteral("EngineResponseTimeout");
+const QString KeyDaemonIdleTimeout = QStringLiteral("DaemonIdleTimeout");
 #endif
 
 using namespace org::deepin::dim;
 
+static InputMethodId defaultLoadedIM()
+{
+    return InputMethodId::get("keyboard", "us");
+}
+
 static const QMap<QString, AddonType> AddonsType = {
     { "Frontend", AddonType::Frontend },
     { "InputMethod", AddonType::InputMethod },
@@ -55,20 +78,55 @@ struct AddonDesc
 };
 } // namespace org::deepin::dim
 
-Dim::Dim(QObject *parent)
+Dim::Dim(QObject *parent, bool headless)
     : QObject(parent)
+    , headless_(headless)
     , focusedInputContext_(0)
 #ifdef Dtk6Core_FOUND
     , dimConf_(DconfigSettings::ConfigPtr(DimDConfigAppID, DimDConfigJson))
 #endif
-    , currentActiveIM_(defaultLoadedIM)
-    , activeInputMethodEntries_({ defaultLoadedIM })
+    , currentActiveIM_(defaultLoadedIM())
+    , activeInputMethodEntries_({ defaultLoadedIM() })
 {
+    Tracer::startFromEnvironment();
+    EventRecorder::startFromEnvironment();
+
+    switchIMTimer_.setSingleShot(true);
+    switchIMTimer_.setInterval(0);
+    connect(&switchIMTimer_, &QTimer::timeout, this, [this]() {
+        if (auto *ic = getInputContext(switchIMInputContext_)) {
+            ic->inputState().switchIM();
+        }
+    });
+
+    focusOutTimer_.setSingleShot(true);
+    focusOutTimer_.setInterval(DEFAULT_FOCUS_OUT_DELAY);
+    connect(&focusOutTimer_, &QTimer::timeout, this, [this]() {
+        flushFocusOut(true);
+    });
+
+    engineResponseTimeout_ = DEFAULT_ENGINE_RESPONSE_TIMEOUT;
+    keyDeadlineTimer_.setSingleShot(true);
+    connect(&keyDeadlineTimer_, &QTimer::timeout, this, &Dim::expireKeys);
+
+    daemonIdleTimeout_ = DEFAULT_DAEMON_IDLE_TIMEOUT;
+    daemonIdleTimer_.setInterval(DAEMON_IDLE_CHECK_INTERVAL);
+    connect(&daemonIdleTimer_, &QTimer::timeout, this, &Dim::reapDaemons);
+
+    if (headless_) {
+        return;
+    }
+
     loadAddons();
 
 #ifdef Dtk6Core_FOUND
     initDConfig();
 #endif
+
+    // the daemons of the other proxy addons are launched once their input methods are used
+    for (const auto &im : activeInputMethodEntries_) {
+        requestDaemon(im);
+    }
 }
 
 Dim::~Dim() { }
@@ -80,15 +138,46 @@ void Dim::initDConfig()
     if (dimConf_) {
         connect(dimConf_, &DConfig::valueChanged, this, [&](const QString &key) {
             if (key == ShareInputState) {
-                // TODO:
+                setInputStateSharing(dimConf_->value(ShareInputState).toInt());
             }
         });
     }
 
+    setInputStateSharing(
+        DconfigSettings::ConfigValue(DimDConfigAppID, DimDConfigJson, ShareInputState, SHARE_NONE)
+            .toInt());
+
+    const int focusOutDelay = DconfigSettings::ConfigValue(DimDConfigAppID,
+                                                           DimDConfigJson,
+                                                           KeyFocusOutDelay,
+                                                           DEFAULT_FOCUS_OUT_DELAY)
+                                  .toInt();
+    focusOutTimer_.setInterval(std::max(focusOutDelay, 0));
+
+    const int engineResponseTimeout = DconfigSettings::ConfigValue(DimDConfigAppID,
+                                                                   DimDConfigJson,
+                                                                   KeyEngineResponseTimeout,
+                                                                   DEFAULT_ENGINE_RESPONSE_TIMEOUT)
+                                          .toInt();
+    engineResponseTimeout_ = std::max(engineResponseTimeout, 0);
+
+    daemonIdleTimeout_ = DconfigSettings::ConfigValue(DimDConfigAppID,
+                                                      DimDConfigJson,
+                                                      KeyDaemonIdleTimeout,
+                                                      DEFAULT_DAEMON_IDLE_TIMEOUT)
+                             .toInt();
+    if (daemonIdleTimeout_ > 0) {
+        daemonIdleTimer_.start();
+    }
+
     QVariant dconfIMKey =
         DconfigSettings::ConfigValue(DimDConfigAppID, DimDConfigJson, KeyCurrentInputSource, "");
-    if (dconfIMKey.isValid() && addons_.count(dconfIMKey.toString().toStdString())) {
-        currentActiveIM_ = keyToIndex(dconfIMKey.toString());
+    if (dconfIMKey.isValid()) {
+        auto im = InputMethodId::fromKey(dconfIMKey.toString());
+        if (im.isValid() && addons_.count(im.addon())) {
+            currentActiveIM_ = im;
+            loadIMEntry(im.addon(), im.name());
+        }
     }
 
     QVariant dconfIMKeys = DconfigSettings::ConfigValue(DimDConfigAppID,
@@ -97,8 +186,11 @@ void Dim::initDConfig()
                                                         "");
     if (dconfIMKeys.isValid()) {
         for (const auto &imKey : dconfIMKeys.toStringList()) {
-            if (addons_.count(imKey.toStdString())) {
-                activeInputMethodEntries_.emplace(keyToIndex(imKey));
+            auto im = InputMethodId::fromKey(imKey);
+            if (im.isValid() && addons_.count(im.addon())) {
+                activeInputMethodEntries_.emplace(im);
+                activeIMEntriesEpoch_++;
+                loadIMEntry(im.addon(), im.name());
             }
         }
     }
@@ -205,181 +297,492 @@ void Dim::loadAddon(const AddonDesc &info)
     auto create = reinterpret_cast<addonCreate *>(createFn);
     Addon *addon = create(this);
 
-    switch (AddonsType[info.category]) {
+    if (!registerAddon(addon, AddonsType[info.category])) {
+        qWarning() << "Addon" << info.name << "has an invalid category" << info.category;
+    }
+}
+
+bool Dim::registerAddon(Addon *addon, AddonType type)
+{
+    switch (type) {
     case AddonType::Frontend: {
         addons_.emplace(addon->key(), addon);
         break;
     }
     case AddonType::InputMethod: {
         auto *imAddon = qobject_cast<InputMethodAddon *>(addon);
+        // before its input methods are reported, their daemon may be requested then
+        if (auto *proxyAddon = qobject_cast<ProxyAddon *>(addon)) {
+            proxyAddons_.emplace_back(proxyAddon);
+        }
         connect(imAddon, &InputMethodAddon::addonInitFinished, this, &Dim::initInputMethodAddon);
         imAddon->initInputMethods();
         addons_.emplace(addon->key(), addon);
         break;
     }
     default:
-        qWarning() << "Addon" << info.name << "has an invalid category" << info.category;
         delete addon;
+        return false;
     }
+
+    return true;
 }
 
+/*
+ * Called whenever an addon reports its input methods. The entries of an addon are kept together
+ * and replaced as a whole, nothing happens if they didn't change.
+ */
 void Dim::initInputMethodAddon(InputMethodAddon *imAddon)
 {
-    for (const auto &entry : imAddon->getInputMethods()) {
-        imEntries_.emplace_back(entry);
+    const auto &entries = imAddon->getInputMethods();
+    const auto &addonKey = imAddon->key();
+
+    auto first = std::find_if(imEntries_.begin(), imEntries_.end(), [&addonKey](const auto &e) {
+        return e.addonKey() == addonKey;
+    });
+    auto last = std::find_if(first, imEntries_.end(), [&addonKey](const auto &e) {
+        return e.addonKey() != addonKey;
+    });
+    if (std::equal(first, last, entries.cbegin(), entries.cend())) {
+        return;
+    }
+
+    first = imEntries_.erase(first, last);
+    imEntries_.insert(first, entries.cbegin(), entries.cend());
+
+    rebuildIMEntryIndex();
+
+    QTimer::singleShot(0, this, [this]() {
+        activeIMEntriesEpoch_++;
+        Q_EMIT inputMethodEntryChanged();
+    });
+}
+
+void Dim::rebuildIMEntryIndex()
+{
+    imEntryIndex_.assign(InputMethodId::maxValue() + 1, 0);
+    for (size_t i = 0; i < imEntries_.size(); i++) {
+        imEntryIndex_[imEntries_[i].id().value()] = i + 1;
     }
 
-    if (!imEntries_.empty()) {
-        QTimer::singleShot(0, [this]() {
-            Q_EMIT inputMethodEntryChanged();
+    imEntriesSerial_++;
+}
+
+const InputMethodEntry *Dim::findIMEntry(InputMethodId im) const
+{
+    // ids interned after the last rebuild have no entry
+    if (im.value() >= imEntryIndex_.size() || imEntryIndex_[im.value()] == 0) {
+        return nullptr;
+    }
+
+    return &imEntries_[imEntryIndex_[im.value()] - 1];
+}
+
+std::vector<InputMethodEntry> Dim::availableIMEntries() const
+{
+    std::vector<InputMethodEntry> entries;
+
+    // in the order of the published entries, which are kept together per addon
+    for (auto first = imEntries_.cbegin(); first != imEntries_.cend();) {
+        const auto &addonKey = first->addonKey();
+        first = std::find_if(first, imEntries_.cend(), [&addonKey](const auto &e) {
+            return e.addonKey() != addonKey;
         });
+
+        auto *imAddon = qobject_cast<InputMethodAddon *>(addons_.at(addonKey));
+        const auto available = imAddon->availableInputMethods();
+        entries.insert(entries.end(), available.cbegin(), available.cend());
     }
+
+    return entries;
+}
+
+template<EventType T, auto Handler>
+bool Dim::dispatchEvent(Dim *dim, Event &event)
+{
+    auto &typedEvent = event_cast<T>(event);
+
+    if constexpr (std::is_same_v<std::invoke_result_t<decltype(Handler), Dim *, EventClass<T> &>,
+                                 bool>) {
+        return (dim->*Handler)(typedEvent);
+    } else {
+        (dim->*Handler)(typedEvent);
+        return false;
+    }
+}
+
+namespace {
+
+// Places each value at the index of its event type, so the tables don't depend on the order of
+// EventType. A missing or repeated type fails to compile.
+template<typename T, size_t N>
+constexpr std::array<T, EVENT_TYPE_CNT> byEventType(const std::pair<EventType, T> (&entries)[N])
+{
+    static_assert(N == EVENT_TYPE_CNT, "every event type needs one entry");
+
+    std::array<T, EVENT_TYPE_CNT> table{};
+    std::array<bool, EVENT_TYPE_CNT> filled{};
+    for (size_t i = 0; i < N; i++) {
+        const auto type = static_cast<size_t>(entries[i].first);
+        if (filled[type]) {
+            throw std::logic_error("repeated event type");
+        }
+
+        filled[type] = true;
+        table[type] = entries[i].second;
+    }
+
+    return table;
 }
 
+} // namespace
+
+const std::array<Dim::EventHandler, EVENT_TYPE_CNT> Dim::eventHandlers_ = []() {
+    // constexpr, so that byEventType() is checked at compile time
+    constexpr auto table = byEventType<EventHandler>({
+        { EventType::InputContextCreated,
+          &Dim::dispatchEvent<EventType::InputContextCreated, &Dim::postInputContextCreated> },
+        { EventType::InputContextDestroyed,
+          &Dim::dispatchEvent<EventType::InputContextDestroyed, &Dim::postInputContextDestroyed> },
+        { EventType::InputContextFocused,
+          &Dim::dispatchEvent<EventType::InputContextFocused, &Dim::postInputContextFocused> },
+        { EventType::InputContextUnfocused,
+          &Dim::dispatchEvent<EventType::InputContextUnfocused, &Dim::postInputContextUnfocused> },
+        { EventType::InputContextKeyEvent,
+          &Dim::dispatchEvent<EventType::InputContextKeyEvent, &Dim::postInputContextKeyEvent> },
+        { EventType::InputContextCursorRectChanged,
+          &Dim::dispatchEvent<EventType::InputContextCursorRectChanged,
+                              &Dim::postInputContextCursorRectChanged> },
+        { EventType::InputContextUpdateContentType,
+          &Dim::dispatchEvent<EventType::InputContextUpdateContentType,
+                              &Dim::postInputContextUpdateContentType> },
+        { EventType::InputContextUpdateSurroundingText,
+          &Dim::dispatchEvent<EventType::InputContextUpdateSurroundingText,
+                              &Dim::postInputContextUpdateSurroundingTextEvent> },
+        { EventType::InputContextDone,
+          &Dim::dispatchEvent<EventType::InputContextDone, &Dim::postInputContextDone> },
+        { EventType::ProxyActiveInputMethodsChanged,
+          &Dim::dispatchEvent<EventType::ProxyActiveInputMethodsChanged,
+                              &Dim::postProxyActivateInputMethodChanged> },
+    });
+
+    return table;
+}();
+
+// span names of the tracer
+static constexpr auto EventTypeNames = byEventType<const char *>({
+    { EventType::InputContextCreated, "InputContextCreated" },
+    { EventType::InputContextDestroyed, "InputContextDestroyed" },
+    { EventType::InputContextFocused, "InputContextFocused" },
+    { EventType::InputContextUnfocused, "InputContextUnfocused" },
+    { EventType::InputContextKeyEvent, "InputContextKeyEvent" },
+    { EventType::InputContextCursorRectChanged, "InputContextCursorRectChanged" },
+    { EventType::InputContextUpdateContentType, "InputContextUpdateContentType" },
+    { EventType::InputContextUpdateSurroundingText, "InputContextUpdateSurroundingText" },
+    { EventType::InputContextDone, "InputContextDone" },
+    { EventType::ProxyActiveInputMethodsChanged, "ProxyActiveInputMethodsChanged" },
+});
+
 bool Dim::postEvent(Event &event)
 {
-    switch (event.type()) {
-    case EventType::InputContextCreated:
-        postInputContextCreated(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextDestroyed:
-        postInputContextDestroyed(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextFocused:
-        postInputContextFocused(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextUnfocused:
-        postInputContextUnfocused(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextKeyEvent:
-        return postInputContextKeyEvent(reinterpret_cast<InputContextKeyEvent &>(event));
-        break;
-    case EventType::InputContextCursorRectChanged:
-        postInputContextCursorRectChanged(
-            reinterpret_cast<InputContextCursorRectChangeEvent &>(event));
-        break;
-    case EventType::InputContextUpdateContentType:
-        postInputContextUpdateContentType(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextUpdateSurroundingText:
-        postInputContextUpdateSurroundingTextEvent(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::InputContextDone:
-        postInputContextDone(reinterpret_cast<InputContextEvent &>(event));
-        break;
-    case EventType::ProxyActiveInputMethodsChanged:
-        postProxyActivateInputMethodChanged(reinterpret_cast<ProxyEvent &>(event));
-        break;
+    const auto type = static_cast<size_t>(event.type());
+
+    DIM_TRACE_SCOPE("dim", EventTypeNames[type]);
+
+    bool res = eventHandlers_[type](this, event);
+
+    const auto &observers = eventObservers_[type];
+    if (!observers.empty()) {
+        notifyEventObservers(observers, event);
     }
 
-    return false;
+    return res;
+}
+
+EventObserverId Dim::addEventObserver(EventType type, std::function<void(Event &event)> observer)
+{
+    Q_ASSERT(!notifyingEventObservers_);
+
+    auto id = ++lastEventObserverId_;
+    eventObservers_[static_cast<size_t>(type)].emplace_back(EventObserver{ id, std::move(observer) });
+
+    return id;
+}
+
+void Dim::removeEventObserver(EventObserverId id)
+{
+    Q_ASSERT(!notifyingEventObservers_);
+
+    for (auto &observers : eventObservers_) {
+        auto iter = std::find_if(observers.begin(), observers.end(), [id](const auto &observer) {
+            return observer.id == id;
+        });
+        if (iter != observers.end()) {
+            observers.erase(iter);
+            return;
+        }
+    }
+}
+
+void Dim::notifyEventObservers(const std::vector<EventObserver> &observers, Event &event)
+{
+    notifyingEventObservers_ = true;
+    for (const auto &observer : observers) {
+        observer.callback(event);
+    }
+    notifyingEventObservers_ = false;
 }
 
 void Dim::postInputContextCreated(InputContextEvent &event)
 {
     auto *ic = event.ic();
 
-    connect(ic, &InputContext::imSwitch, this, &Dim::switchIM);
+    connect(ic, &InputContext::imSwitch, this, [this, ic](InputMethodId im) {
+        switchIM(im);
+
+        if (inputStateSharing_ == SHARE_PROGRAM && !ic->appId().empty()) {
+            appInputStates_.store(ic->appId(), im);
+        }
+
+        // hand the focus over to the addon of the new input method
+        auto &state = ic->inputState();
+        auto *oldProxy = state.focusedProxy_;
+        routeFocus(ic, focusedInputContext_ == ic->id());
+        if (state.focusedProxy_ != oldProxy) {
+            if (state.focusedProxy_) {
+                auto &contentType = ic->contentType();
+                state.focusedProxy_->contentType(contentType.hint(), contentType.purpose());
+            }
+            flushDone(ic);
+        }
+    });
 
-    inputContexts_.emplace(ic->id(), ic);
+    ic->id_ = inputContexts_.insert(ic);
+    if (!ic->id_) {
+        qWarning() << "too many input contexts";
+    }
 }
 
 void Dim::postInputContextDestroyed(InputContextEvent &event)
 {
     auto *ic = event.ic();
 
+    if (pendingFocusOut_ == ic->id()) {
+        flushFocusOut(true);
+    }
+
     inputContexts_.erase(ic->id());
 
-    loopProxyAddon([ic](ProxyAddon *addon) {
-        addon->destroyed(ic->id());
-    });
+    // destroyed without a focus out, its handle must not be left behind
+    if (focusedInputContext_ == ic->id()) {
+        focusedInputContext_ = 0;
+        emit focusedInputContextChanged(focusedInputContext_);
+    }
+
+    for (auto *proxyAddon : ic->inputState().seenProxies_) {
+        proxyAddon->destroyed(ic->id());
+    }
 }
 
 void Dim::postInputContextFocused(InputContextEvent &event)
 {
     auto *ic = event.ic();
 
+    ic->inputState_.revalidate();
+    focusTransitions_++;
+
+    if (pendingFocusOut_ == ic->id()) {
+        // focused out and in again, e.g. by alt-tab or a popup, the engine keeps its state
+        focusOutTimer_.stop();
+        pendingFocusOut_ = 0;
+        pendingFocusOutDone_ = false;
+        // neither the out nor the in reach the engine
+        suppressedFocusTransitions_ += 2;
+
+        // unless an input method switch meanwhile handed the focus out already
+        if (!ic->inputState().focusedProxy_) {
+            ic->deliveredSurroundingText_ = {};
+            ic->deliveredCursorRect_ = {};
+        }
+
+        focusedInputContext_ = ic->id();
+        routeFocus(ic, true);
+        return;
+    }
+
+    // the focus moved to another input context, the signal below replaces the pending one
+    flushFocusOut(false);
+
+    // before routing the focus, so the proxy of the shared input method gets it
+    applyInputStateSharing(ic);
+
     focusedInputContext_ = ic->id();
     emit focusedInputContextChanged(focusedInputContext_);
 
-    loopProxyAddon([ic](ProxyAddon *addon) {
-        addon->focusIn(ic->id());
-    });
+    // the engine may have got the state of another input context meanwhile
+    ic->deliveredSurroundingText_ = {};
+    ic->deliveredCursorRect_ = {};
+
+    routeFocus(ic, true);
 }
 
+/*
+ * The focus out is held back until the event loop is idle (or FocusOutDelay has passed), so an
+ * out and in of the same input context doesn't reset the engine.
+ */
 void Dim::postInputContextUnfocused(InputContextEvent &event)
 {
     auto *ic = event.ic();
 
-    focusedInputContext_ = 0;
-    emit focusedInputContextChanged(focusedInputContext_);
+    if (pendingFocusOut_ != ic->id()) {
+        flushFocusOut(true);
+    }
 
-    loopProxyAddon([ic](ProxyAddon *addon) {
-        addon->focusOut(ic->id());
-    });
+    focusTransitions_++;
+    focusedInputContext_ = 0;
+    pendingFocusOut_ = ic->id();
+    focusOutTimer_.start();
 }
 
 bool Dim::postInputContextKeyEvent(InputContextKeyEvent &event)
 {
     auto &inputState = event.ic()->inputState();
+    inputState.revalidate();
 
     if (!event.isRelease() && event.state() & CONTROL_MASK && event.keySym() == XK_Shift_L) {
-        QTimer::singleShot(0, [ic = event.ic()]() {
-            ic->inputState().switchIM();
-        });
+        switchIMInputContext_ = event.ic()->id();
+        switchIMTimer_.start();
         return true;
     }
 
-    auto addon = getInputMethodAddon(inputState);
+    // resolved when the input method changes, no lookup is done per key
+    const auto *entry = inputState.resolvedIMEntry();
+    auto *addon = inputState.resolvedIMAddon();
+    if (!entry || !addon) {
+        return false;
+    }
 
-    auto entryIter = std::find_if(
-        imEntries_.cbegin(),
-        imEntries_.cend(),
-        [&currentIMEntry = inputState.currentIMEntry()](const InputMethodEntry &entry) {
-            return entry.addonKey() == currentIMEntry.first
-                && entry.uniqueName() == currentIMEntry.second;
-        });
-    if (addon) {
-        return addon->keyEvent(*entryIter, event);
+    auto &keyPipeline = event.ic()->keyPipeline_;
+    auto *proxy = inputState.resolvedProxyAddon();
+    if (proxy) {
+        // the press went to the application past the engine, so does its release
+        if (event.isRelease() && keyPipeline.takePassed(event.keycode())) {
+            return keyPipeline.pass(event.keycode(), false);
+        }
+
+        if (proxy->isDegraded(event.timestamp(InputContextKeyEvent::STAGE_RECEIVED))) {
+            return keyPipeline.pass(event.keycode(), !event.isRelease());
+        }
     }
 
-    return false;
+    // the commit of a key press completes its measurement, see InputContext::commit()
+    auto &pendingKey = event.ic()->pendingKey_;
+    if (!event.isRelease()) {
+        pendingKey = { addon, event.timestamp(InputContextKeyEvent::STAGE_RECEIVED), 0 };
+    }
+
+    event.stamp(InputContextKeyEvent::STAGE_DISPATCHED);
+    bool res = addon->keyEvent(*entry, event);
+    event.stamp(InputContextKeyEvent::STAGE_HANDLED);
+
+    const uint64_t received = event.timestamp(InputContextKeyEvent::STAGE_RECEIVED);
+    const uint64_t dispatched = event.timestamp(InputContextKeyEvent::STAGE_DISPATCHED);
+    const uint64_t handled = event.timestamp(InputContextKeyEvent::STAGE_HANDLED);
+    addon->keyLatency(InputMethodAddon::KEY_LATENCY_DISPATCH).record(dispatched - received);
+    addon->keyLatency(InputMethodAddon::KEY_LATENCY_ADDON).record(handled - dispatched);
+
+    if (!event.isRelease() && pendingKey.addon) {
+        if (res) {
+            pendingKey.handledUs = handled;
+        } else {
+            // the key goes back to the application
+            pendingKey.addon = nullptr;
+        }
+    }
+
+    if (res) {
+        // The answers of the proxy engine come later. Engines take modifiers silently, they
+        // aren't waited for. Without a deadline nothing bounds the wait for a key the engine
+        // swallowed, the keys aren't held back then.
+        if (proxy && event.serial() && engineResponseTimeout_
+            && (event.keySym() < XK_Shift_L || event.keySym() > XK_Hyper_R)) {
+            if (event.ic()->keyProxy_ != proxy) {
+                keyPipeline.flush();
+                event.ic()->keyProxy_ = proxy;
+            }
+            keyPipeline.send(event.serial(), event.keycode(), !event.isRelease(), handled);
+
+            if (!keyDeadlineTimer_.isActive()) {
+                keyDeadlineTimer_.start(engineResponseTimeout_);
+            }
+        }
+    } else {
+        // must not overtake the keys in the engine
+        res = keyPipeline.pass(event.keycode(), !event.isRelease());
+    }
+
+    return res;
 }
 
 void Dim::postInputContextCursorRectChanged(InputContextCursorRectChangeEvent &event)
 {
-    auto addon = qobject_cast<ProxyAddon *>(getInputMethodAddon(event.ic()->inputState()));
-    if (addon) {
-        addon->cursorRectangleChangeEvent(event);
+    auto *ic = event.ic();
+    auto *addon = ic->inputState().resolvedProxyAddon();
+    if (!addon) {
+        return;
     }
+
+    const InputContext::DeliveredCursorRect rect{ addon, event.x, event.y, event.w, event.h };
+    auto &delivered = ic->deliveredCursorRect_;
+    if (delivered.addon == rect.addon && delivered.x == rect.x && delivered.y == rect.y
+        && delivered.w == rect.w && delivered.h == rect.h) {
+        return;
+    }
+
+    delivered = rect;
+    addon->cursorRectangleChangeEvent(event);
 }
 
 void Dim::postInputContextUpdateContentType(InputContextEvent &event)
 {
     auto *ic = event.ic();
 
-    loopProxyAddon([ic](ProxyAddon *addon) {
+    // sent before the focus, so it goes to the owner of the input method rather than the focus
+    auto *addon = ic->inputState().resolvedProxyAddon();
+    if (addon) {
         auto &contentType = ic->contentType();
 
         addon->contentType(contentType.hint(), contentType.purpose());
-    });
+    }
 }
 
 void Dim::postInputContextUpdateSurroundingTextEvent(InputContextEvent &event)
 {
-    auto addon = getInputMethodAddon(event.ic()->inputState());
-    if (addon) {
-        addon->updateSurroundingText(event);
+    auto *ic = event.ic();
+    auto addon = getInputMethodAddon(ic->inputState());
+    if (!addon) {
+        return;
     }
+
+    auto &delivered = ic->deliveredSurroundingText_;
+    const uint64_t version = ic->surroundingText().version();
+    if (delivered.addon == addon && delivered.version == version) {
+        return;
+    }
+
+    delivered = { addon, version };
+    addon->updateSurroundingText(event);
 }
 
 void Dim::postInputContextDone(InputContextEvent &event)
 {
-    auto *ic = event.ic();
+    // the proxies haven't seen the focus out yet, the done goes with it
+    if (pendingFocusOut_ == event.ic()->id()) {
+        pendingFocusOutDone_ = true;
+        return;
+    }
 
-    loopProxyAddon([ic](ProxyAddon *addon) {
-        addon->done();
-    });
+    flushDone(event.ic());
 }
 
 void Dim::postProxyActivateInputMethodChanged(ProxyEvent &event)
@@ -389,25 +792,45 @@ void Dim::postProxyActivateInputMethodChanged(ProxyEvent &event)
 
     auto &list = proxyAddon->activeInputMethods();
     for (const auto &entry : list) {
-        addActiveInputMethodEntry(addonKey, entry);
+        addActiveInputMethodEntry(InputMethodId::get(addonKey, entry));
     }
 }
 
-void Dim::addActiveInputMethodEntry(const std::string &addon, const std::string &entry)
+void Dim::addActiveInputMethodEntry(InputMethodId im)
 {
-    auto [_, res] = activeInputMethodEntries_.emplace(std::make_pair(addon, entry));
+    auto [_, res] = activeInputMethodEntries_.emplace(im);
     if (!res) {
         return;
     }
+    activeIMEntriesEpoch_++;
+    loadIMEntry(im.addon(), im.name());
+    requestDaemon(im);
 
 #ifdef Dtk6Core_FOUND
     updateDconfInputMethodEntries();
 #endif
 }
 
+const InputMethodEntry *Dim::loadIMEntry(const std::string &addon, const std::string &name)
+{
+    if (const auto *entry = findIMEntry(InputMethodId::find(addon, name))) {
+        return entry;
+    }
+
+    auto iter = addons_.find(addon);
+    auto *imAddon =
+        iter != addons_.end() ? qobject_cast<InputMethodAddon *>(iter->second) : nullptr;
+    if (!imAddon || !imAddon->publishInputMethod(name)) {
+        return nullptr;
+    }
+
+    // published through addonInitFinished, see initInputMethodAddon()
+    return findIMEntry(InputMethodId::find(addon, name));
+}
+
 InputMethodAddon *Dim::getInputMethodAddon(const InputState &inputState)
 {
-    const std::string &addonKey = inputState.currentIMEntry().first;
+    const std::string &addonKey = inputState.currentIMEntry().addon();
     auto j = addons().find(addonKey);
     assert(j != addons().end());
 
@@ -417,50 +840,244 @@ InputMethodAddon *Dim::getInputMethodAddon(const InputState &inputState)
     return imAddon;
 }
 
-void Dim::loopProxyAddon(const std::function<void(ProxyAddon *addon)> callback)
+/*
+ * Only the proxy addon owning the current input method of an input context gets its focus, so
+ * the daemons of the other frameworks don't activate and deactivate on every focus change.
+ */
+void Dim::routeFocus(InputContext *ic, bool focused)
+{
+    auto &state = ic->inputState();
+
+    auto *owner = focused ? state.resolvedProxyAddon() : nullptr;
+    if (state.focusedProxy_ == owner) {
+        return;
+    }
+
+    // the engine which had the focus won't answer the keys it got any more
+    ic->keyPipeline_.flush();
+
+    if (state.focusedProxy_) {
+        state.focusedProxy_->focusOut(ic->id());
+        state.unfocusedProxy_ = state.focusedProxy_;
+    }
+
+    state.focusedProxy_ = owner;
+
+    if (owner) {
+        owner->requestDaemon();
+        owner->focusIn(ic->id());
+
+        if (std::find(state.seenProxies_.cbegin(), state.seenProxies_.cend(), owner)
+            == state.seenProxies_.cend()) {
+            state.seenProxies_.emplace_back(owner);
+        }
+    }
+}
+
+void Dim::expireKeys()
 {
-    for (const auto &[_, v] : addons_) {
-        auto addon = qobject_cast<ProxyAddon *>(v);
-        if (addon) {
-            callback(addon);
+    const uint64_t now = getMonotonicUs();
+    const uint64_t timeout = static_cast<uint64_t>(engineResponseTimeout_) * 1000;
+    uint64_t nextDeadline = UINT64_MAX;
+
+    for (auto *ic : inputContexts_) {
+        auto &keyPipeline = ic->keyPipeline_;
+        auto *proxy = ic->keyProxy_;
+        if (!keyPipeline.inFlight() || !proxy) {
+            continue;
+        }
+
+        // the engine hasn't answered on the channel the keys went through
+        const uint64_t beforeUs = now > timeout ? now - timeout : 0;
+        const uint32_t expired = keyPipeline.expire(beforeUs, [proxy, ic](uint32_t keycode) {
+            proxy->releaseKey(ic->id(), keycode);
+        });
+        for (uint32_t i = 0; i < expired; i++) {
+            proxy->keyMissed(now);
+        }
+
+        if (keyPipeline.inFlight()) {
+            nextDeadline = std::min(nextDeadline, keyPipeline.oldestSentUs() + timeout);
         }
     }
+
+    if (engineResponseTimeout_ && nextDeadline != UINT64_MAX) {
+        keyDeadlineTimer_.start(static_cast<int>((nextDeadline - now + 999) / 1000));
+    }
 }
 
-void Dim::switchIM(const std::pair<std::string, std::string> &imIndex)
+void Dim::requestDaemon(InputMethodId im)
 {
-    qWarning() << "imIndex.first:" << imIndex.first.c_str();
-    auto addon = qobject_cast<ProxyAddon *>(addons_.at(imIndex.first));
+    for (auto *proxy : proxyAddons_) {
+        if (proxy->key() == im.addon()) {
+            proxy->requestDaemon();
+            return;
+        }
+    }
+}
 
-    if (addon) {
-        addon->setCurrentIM(imIndex.second);
+void Dim::reapDaemons()
+{
+    const uint64_t now = getMonotonicUs();
+    const uint64_t timeout = static_cast<uint64_t>(daemonIdleTimeout_) * 60 * 1000000;
+    if (daemonIdleTimeout_ <= 0 || now < timeout) {
+        return;
+    }
+
+    for (auto *proxy : proxyAddons_) {
+        // the current input method is used again soon, focused input contexts at any time
+        if (proxy->key() == currentActiveIM_.addon()) {
+            continue;
+        }
+
+        const bool focused =
+            std::any_of(inputContexts_.begin(), inputContexts_.end(), [proxy](auto *ic) {
+                return ic->inputState().focusedProxy_ == proxy;
+            });
+        if (!focused) {
+            proxy->reapDaemon(now - timeout);
+        }
+    }
+}
+
+void Dim::flushDone(InputContext *ic)
+{
+    auto &state = ic->inputState();
+
+    if (state.unfocusedProxy_ && state.unfocusedProxy_ != state.focusedProxy_) {
+        state.unfocusedProxy_->done();
+    }
+    state.unfocusedProxy_ = nullptr;
+
+    if (state.focusedProxy_) {
+        state.focusedProxy_->done();
+    }
+}
+
+void Dim::flushFocusOut(bool notify)
+{
+    if (!pendingFocusOut_) {
+        return;
+    }
+
+    focusOutTimer_.stop();
+
+    const uint32_t id = pendingFocusOut_;
+    const bool done = pendingFocusOutDone_;
+    pendingFocusOut_ = 0;
+    pendingFocusOutDone_ = false;
+
+    if (notify && focusedInputContext_ == 0) {
+        emit focusedInputContextChanged(focusedInputContext_);
+    }
+
+    auto *ic = getInputContext(id);
+    if (!ic) {
+        return;
+    }
+
+    routeFocus(ic, false);
+    if (done) {
+        flushDone(ic);
+    }
+}
+
+void Dim::setInputStateSharing(int sharing)
+{
+    if (sharing < SHARE_NONE || sharing > SHARE_ALL) {
+        qWarning() << "invalid ShareInputState" << sharing;
+        sharing = SHARE_NONE;
+    }
+
+    inputStateSharing_ = static_cast<InputStateSharing>(sharing);
+
+    if (inputStateSharing_ == SHARE_PROGRAM && !appInputStates_.isOpen()) {
+        appInputStates_.open(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+                             + QStringLiteral("/deepin-im/app-input-states"));
+    }
+}
+
+/*
+ * Gives a focused input context the input method the policy shares with it, and switches the
+ * addon to the input method of the input context, so the engine is ready before the first key.
+ */
+void Dim::applyInputStateSharing(InputContext *ic)
+{
+    auto &state = ic->inputState_;
+
+    switch (inputStateSharing_) {
+    case SHARE_PROGRAM:
+        if (!ic->appId().empty()) {
+            const auto im = appInputStates_.find(ic->appId());
+            if (im.isValid()) {
+                state.restoreIM(im);
+            } else {
+                appInputStates_.store(ic->appId(), state.currentIMEntry());
+            }
+        }
+        break;
+    case SHARE_ALL:
+        state.restoreIM(currentActiveIM_);
+        break;
+    case SHARE_NONE:
+        break;
+    }
+
+    // only the engine follows the focus, CurrentInputSource keeps the input method the user chose
+    if (state.currentIMEntry() != activatedIM_ && state.resolvedIMAddon()) {
+        activateIM(state.currentIMEntry());
+    }
+}
 
-        currentActiveIM_ = imIndex;
+void Dim::resetFocusTransitionStats()
+{
+    focusTransitions_ = 0;
+    suppressedFocusTransitions_ = 0;
+}
+
+bool Dim::activateIM(InputMethodId im)
+{
+    auto addon = qobject_cast<InputMethodAddon *>(addons_.at(im.addon()));
+    if (!addon) {
+        return false;
+    }
+
+    requestDaemon(im);
+    addon->setCurrentIM(im.name());
+    activatedIM_ = im;
+
+    return true;
+}
+
+void Dim::switchIM(InputMethodId im)
+{
+    if (activateIM(im)) {
+        currentActiveIM_ = im;
 
 #ifdef Dtk6Core_FOUND
+        if (headless_) {
+            return;
+        }
+
         DconfigSettings::ConfigSaveValue(DimDConfigAppID,
                                          DimDConfigJson,
                                          KeyCurrentInputSource,
-                                         QVariant::fromValue(indexToKey(currentActiveIM_)));
+                                         QVariant::fromValue(currentActiveIM_.toKey()));
 #endif
     }
 }
 
 bool Dim::requestSwitchIM(const std::string &addon, const std::string &name)
 {
-    auto iter = std::find_if(activeInputMethodEntries().cbegin(),
-                             activeInputMethodEntries().cend(),
-                             [&addon, &name](const auto &pair) {
-                                 return (pair.first == addon) && pair.second == name;
-                             });
-    if (iter == activeInputMethodEntries().cend()) {
+    auto im = InputMethodId::find(addon, name);
+    if (!activeInputMethodEntries_.count(im)) {
         qDebug() << "invalid input method " << QString::fromStdString(name);
         return false;
     }
 
     auto currentFocusedIc = getFocusedIC(focusedInputContext());
     if (currentFocusedIc) {
-        currentFocusedIc->inputState().requestSwitchIM(addon, name);
+        currentFocusedIc->inputState().requestSwitchIM(im);
         return true;
     }
 
@@ -482,17 +1099,15 @@ void Dim::toggle()
  */
 void Dim::addInputMethod(const std::string &addon, const std::string &name)
 {
-    auto iter = std::find_if(imEntries().cbegin(),
-                             imEntries().cend(),
-                             [&addon, &name](const InputMethodEntry &entry) {
-                                 return (entry.addonKey() == addon) && entry.uniqueName() == name;
-                             });
-    if (iter == imEntries().cend()) {
+    const auto *entry = loadIMEntry(addon, name);
+    if (!entry) {
         qDebug() << "invalid input method " << QString::fromStdString(name);
         return;
     }
 
-    activeInputMethodEntries_.emplace(std::make_pair(iter->addonKey(), iter->uniqueName()));
+    activeInputMethodEntries_.emplace(entry->id());
+    activeIMEntriesEpoch_++;
+    requestDaemon(entry->id());
 #ifdef Dtk6Core_FOUND
     updateDconfInputMethodEntries();
 #endif
@@ -505,42 +1120,26 @@ void Dim::addInputMethod(const std::string &addon, const std::string &name)
  */
 void Dim::removeInputMethod(const std::string &addon, const std::string &name)
 {
-    auto iter = std::find_if(activeInputMethodEntries().cbegin(),
-                             activeInputMethodEntries().cend(),
-                             [&addon, &name](const auto &pair) {
-                                 return (pair.first == addon) && pair.second == name;
-                             });
-    if (iter == activeInputMethodEntries().cend()) {
+    auto iter = activeInputMethodEntries_.find(InputMethodId::find(addon, name));
+    if (iter == activeInputMethodEntries_.cend()) {
         qDebug() << "invalid input method " << QString::fromStdString(name);
         return;
     }
 
     activeInputMethodEntries_.erase(iter);
+    activeIMEntriesEpoch_++;
 #ifdef Dtk6Core_FOUND
     updateDconfInputMethodEntries();
 #endif
 }
 
-QString Dim::indexToKey(const std::pair<std::string, std::string> &imIndex) const
-{
-    return QString("%1:%2")
-        .arg(QString::fromStdString(imIndex.first))
-        .arg(QString::fromStdString(imIndex.second));
-}
-
-const std::pair<std::string, std::string> Dim::keyToIndex(const QString &imKey) const
-{
-    QStringList keys = imKey.split(":");
-
-    // TODO: need to judge validity of imKey
-    Q_ASSERT(keys.size() == 2);
-
-    return std::make_pair(keys[0].toStdString(), keys[1].toStdString());
-}
-
 #ifdef Dtk6Core_FOUND
 void Dim::updateDconfInputMethodEntries() const
 {
+    if (headless_) {
+        return;
+    }
+
     QVariant dconfIMKeys = DconfigSettings::ConfigValue(DimDConfigAppID,
                                                         DimDConfigJson,
                                                         KeyCurrentUserInputSources,
@@ -551,7 +1150,7 @@ void Dim::updateDconfInputMethodEntries() const
     auto imKeys = dconfIMKeys.toStringList();
 
     for (const auto &entry : activeInputMethodEntries()) {
-        const auto &key = indexToKey(entry);
+        const auto &key = entry.toKey();
         if (!imKeys.contains(key)) {
             imKeys.append(key);
         }
@@ -564,17 +1163,18 @@ void Dim::updateDconfInputMethodEntries() const
 }
 #endif
 
+InputContext *Dim::getInputContext(uint32_t id) const
+{
+    auto *ic = inputContexts_.find(id);
+
+    return ic ? *ic : nullptr;
+}
+
 InputContext *Dim::getFocusedIC(uint32_t id) const
 {
     if (focusedInputContext() != id) {
         return nullptr;
     }
 
-    auto &ics = getInputContexts();
-    auto it = ics.find((id));
-    if (it == ics.cend()) {
-        return nullptr;
-    }
-
-    return it->second;
+    return getInputContext(id);
 }
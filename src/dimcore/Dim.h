@@ -5,10 +5,16 @@
 #ifndef DIM_H
 #define DIM_H
 
+#include "AppInputStateCache.h"
+#include "Events.h"
 #include "InputMethodEntry.h"
+#include "SlotMap.h"
 
 #include <QObject>
+#include <QTimer>
 
+#include <array>
+#include <functional>
 #include <set>
 
 #ifdef Dtk6Core_FOUND
@@ -24,64 +30,118 @@ enum AddonType {
     InputMethod,
 };
 
+// the ShareInputState policies, which input contexts share their input method
+enum InputStateSharing {
+    SHARE_NONE = 0, // every input context keeps its own
+    SHARE_PROGRAM = 1, // the input contexts of an application share one
+    SHARE_ALL = 2, // all input contexts share the current input method
+};
+
 class InputContext;
 class InputState;
 class InputMethodAddon;
 class ProxyAddon;
 class FrontendAddon;
 class Addon;
-class Event;
-class InputContextEvent;
-class InputContextKeyEvent;
-class InputContextCursorRectChangeEvent;
 class InputContextSetSurroundingTextEvent;
-class ProxyEvent;
 
 struct AddonDesc;
 
+using EventObserverId = uint32_t;
+
 class Dim : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit Dim(QObject *parent = nullptr);
+    // A headless Dim neither loads the addons in DIM_ADDON_INFO_DIR nor reads or writes DConfig,
+    // the addons have to be added with registerAddon(). Used by dim-bench.
+    explicit Dim(QObject *parent = nullptr, bool headless = false);
     ~Dim();
 
     bool postEvent(Event &event);
 
-    const std::unordered_map<uint32_t, InputContext *> &getInputContexts() const
+    // takes the ownership of addon, returns false if type is invalid
+    bool registerAddon(Addon *addon, AddonType type);
+
+    // Observers are called after Dim has handled an event. Events without observers don't pay
+    // anything for this. Observers must not be added or removed from an observer.
+    template<EventType T>
+    EventObserverId addEventObserver(std::function<void(EventClass<T> &event)> observer)
     {
-        return inputContexts_;
+        return addEventObserver(T, [observer = std::move(observer)](Event &event) {
+            observer(event_cast<T>(event));
+        });
     }
 
+    void removeEventObserver(EventObserverId id);
+
+    const SlotMap<InputContext *> &getInputContexts() const { return inputContexts_; }
+
+    // nullptr if id is stale
+    InputContext *getInputContext(uint32_t id) const;
     InputContext *getFocusedIC(uint32_t id) const;
 
     const std::unordered_map<std::string, Addon *> &addons() const { return addons_; }
 
+    const std::vector<ProxyAddon *> &proxyAddons() const { return proxyAddons_; }
+
     const auto &activeInputMethodEntries() const { return activeInputMethodEntries_; }
 
+    // changes whenever the active input methods or their entries change, the input states
+    // revalidate their input method against it on their next key or focus event
+    uint64_t activeIMEntriesEpoch() const { return activeIMEntriesEpoch_; }
+
     const auto &getCurrentActiveInputMethod() const { return currentActiveIM_; }
 
     const std::vector<InputMethodEntry> &imEntries() const { return imEntries_; }
 
-    int focusedInputContext() const { return focusedInputContext_; }
+    // changes whenever imEntries() is modified, entry pointers are only valid until then
+    uint64_t imEntriesSerial() const { return imEntriesSerial_; }
+
+    const InputMethodEntry *findIMEntry(InputMethodId im) const;
+    // every input method the addons provide, including the ones which aren't published
+    std::vector<InputMethodEntry> availableIMEntries() const;
+
+    uint32_t focusedInputContext() const { return focusedInputContext_; }
+
+    // focus changes of input contexts, and how many of them were cancelled by a focus in of the
+    // same input context before the focus out was delivered to the engine
+    uint64_t focusTransitions() const { return focusTransitions_; }
+    uint64_t suppressedFocusTransitions() const { return suppressedFocusTransitions_; }
+    void resetFocusTransitionStats();
 
     void addInputMethod(const std::string &addon, const std::string &name);
     void removeInputMethod(const std::string &addon, const std::string &name);
 
 Q_SIGNALS:
-    void focusedInputContextChanged(int focusedInputContext);
+    void focusedInputContextChanged(uint32_t focusedInputContext);
     void inputMethodEntryChanged();
 
 public Q_SLOTS:
-    void switchIM(const std::pair<std::string, std::string> &imIndex);
+    void switchIM(InputMethodId im);
     bool requestSwitchIM(const std::string &addon, const std::string &name);
     void toggle();
 
 private:
+    using EventHandler = bool (*)(Dim *dim, Event &event);
+
+    struct EventObserver
+    {
+        EventObserverId id;
+        std::function<void(Event &event)> callback;
+    };
+
+    template<EventType T, auto Handler>
+    static bool dispatchEvent(Dim *dim, Event &event);
+
+    EventObserverId addEventObserver(EventType type, std::function<void(Event &event)> observer);
+    void notifyEventObservers(const std::vector<EventObserver> &observers, Event &event);
+
     void loadAddons();
     void loadAddon(const AddonDesc &infoFile);
     void initInputMethodAddon(InputMethodAddon *imAddon);
+    void rebuildIMEntryIndex();
     void postInputContextCreated(InputContextEvent &event);
     void postInputContextDestroyed(InputContextEvent &event);
     void postInputContextFocused(InputContextEvent &event);
@@ -92,23 +152,66 @@ private:
     void postInputContextUpdateSurroundingTextEvent(InputContextEvent &event);
     void postInputContextDone(InputContextEvent &event);
     void postProxyActivateInputMethodChanged(ProxyEvent &event);
-    void addActiveInputMethodEntry(const std::string &addon, const std::string &entry);
+    void addActiveInputMethodEntry(InputMethodId im);
+    // the entry of an input method, published by its addon first if needed
+    const InputMethodEntry *loadIMEntry(const std::string &addon, const std::string &name);
     InputMethodAddon *getInputMethodAddon(const InputState &state);
-    void loopProxyAddon(const std::function<void(ProxyAddon *addon)> callback);
-    QString indexToKey(const std::pair<std::string, std::string> &imIndex) const;
-    const std::pair<std::string, std::string> keyToIndex(const QString &imKey) const;
+    void routeFocus(InputContext *ic, bool focused);
+    void flushDone(InputContext *ic);
+    // passes the key presses the proxy engines didn't answer in time to the applications
+    void expireKeys();
+    // launches the daemon of the proxy addon of im, if it has one
+    void requestDaemon(InputMethodId im);
+    // stops the daemons which weren't used for daemonIdleTimeout_ minutes
+    void reapDaemons();
+    void flushFocusOut(bool notify);
+    void setInputStateSharing(int sharing);
+    void applyInputStateSharing(InputContext *ic);
+    // switches the addon of im to it without making it the current input method, false if im
+    // doesn't belong to an input method addon
+    bool activateIM(InputMethodId im);
 #ifdef Dtk6Core_FOUND
     void initDConfig();
     void updateDconfInputMethodEntries() const;
 #endif
 
 private:
-    std::unordered_map<uint32_t, InputContext *> inputContexts_;
+    SlotMap<InputContext *> inputContexts_;
+    const bool headless_;
     uint32_t focusedInputContext_;
     std::unordered_map<std::string, Addon *> addons_;
+    std::vector<ProxyAddon *> proxyAddons_;
+    static const std::array<EventHandler, EVENT_TYPE_CNT> eventHandlers_;
+    std::array<std::vector<EventObserver>, EVENT_TYPE_CNT> eventObservers_;
+    EventObserverId lastEventObserverId_ = 0;
+    bool notifyingEventObservers_ = false;
     std::vector<InputMethodEntry> imEntries_;
-    std::set<std::pair<std::string, std::string>> activeInputMethodEntries_;
-    std::pair<std::string, std::string> currentActiveIM_;
+    // input method id -> index + 1 in imEntries_, 0 if the input method has no entry
+    std::vector<uint32_t> imEntryIndex_;
+    uint64_t imEntriesSerial_ = 1;
+    InputMethodIdSet activeInputMethodEntries_;
+    uint64_t activeIMEntriesEpoch_ = 1;
+    InputMethodId currentActiveIM_;
+    // the input method the addons were last switched to, it follows the focused input context
+    InputMethodId activatedIM_;
+    InputStateSharing inputStateSharing_ = SHARE_NONE;
+    // the input method of each application for SHARE_PROGRAM, opened on first use
+    AppInputStateCache appInputStates_;
+    // switches the input method of switchIMInputContext_ after the shortcut's key event returned
+    QTimer switchIMTimer_;
+    uint32_t switchIMInputContext_ = 0;
+    // delivers the focus out of pendingFocusOut_ unless it's focused again before the timeout
+    QTimer focusOutTimer_;
+    uint32_t pendingFocusOut_ = 0;
+    // a done of pendingFocusOut_ arrived while its focus out was held back
+    bool pendingFocusOutDone_ = false;
+    uint64_t focusTransitions_ = 0;
+    uint64_t suppressedFocusTransitions_ = 0;
+    // fires at the deadline of the oldest key press in a proxy engine
+    QTimer keyDeadlineTimer_;
+    int engineResponseTimeout_;
+    QTimer daemonIdleTimer_;
+    int daemonIdleTimeout_;
 #ifdef Dtk6Core_FOUND
     DTK_CORE_NAMESPACE::DConfig *dimConf_;
 #endif
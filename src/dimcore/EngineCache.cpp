@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "EngineCache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+using namespace org::deepin::dim;
+
+constexpr quint32 CACHE_MAGIC = 0x44494245; // "DIBE"
+constexpr quint32 CACHE_VERSION = 1;
+
+QString EngineCache::path(const std::string &addonKey)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/deepin-im/") + QString::fromStdString(addonKey)
+        + QStringLiteral("-engines.cache");
+}
+
+uint64_t EngineCache::stamp(const QStringList &files)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    auto mix = [&hash](const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3;
+        }
+    };
+
+    for (const auto &file : files) {
+        QFileInfo info(file);
+        const qint64 size = info.exists() ? info.size() : -1;
+        const qint64 mtime = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+
+        mix(&size, sizeof(size));
+        mix(&mtime, sizeof(mtime));
+    }
+
+    return hash;
+}
+
+EngineCache::State EngineCache::load(const QString &path,
+                                     uint64_t stamp,
+                                     const std::string &addonKey,
+                                     QList<InputMethodEntry> &entries)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return MISSING;
+    }
+
+    QDataStream in(&file);
+    quint32 magic, version, count;
+    quint64 fileStamp;
+    in >> magic >> version >> fileStamp >> count;
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION) {
+        return MISSING;
+    }
+
+    QList<InputMethodEntry> loaded;
+    loaded.reserve(count);
+    for (quint32 i = 0; i < count; i++) {
+        QByteArray uniqueName, name, description, label, iconName;
+        in >> uniqueName >> name >> description >> label >> iconName;
+        if (in.status() != QDataStream::Ok) {
+            return MISSING;
+        }
+
+        loaded.append(InputMethodEntry(addonKey,
+                                       uniqueName.toStdString(),
+                                       name.toStdString(),
+                                       description.toStdString(),
+                                       label.toStdString(),
+                                       iconName.toStdString()));
+    }
+
+    entries.swap(loaded);
+
+    return fileStamp == stamp ? CURRENT : STALE;
+}
+
+bool EngineCache::save(const QString &path, uint64_t stamp, const QList<InputMethodEntry> &entries)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to write engine cache" << path;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << CACHE_MAGIC << CACHE_VERSION << quint64(stamp) << quint32(entries.size());
+    for (const auto &entry : entries) {
+        out << QByteArray::fromStdString(entry.uniqueName())
+            << QByteArray::fromStdString(entry.name())
+            << QByteArray::fromStdString(entry.description())
+            << QByteArray::fromStdString(entry.label())
+            << QByteArray::fromStdString(entry.iconName());
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "failed to write engine cache" << path;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef ENGINECACHE_H
+#define ENGINECACHE_H
+
+#include "InputMethodEntry.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// The input methods of a proxy addon, cached across restarts.
+//
+// Listing them takes a running engine daemon, which is only launched once one of them is used, so
+// the entries got from it are written to a file and published from there until it's up. The
+// file records a stamp of files which change when engines are installed or removed, e.g. the ibus
+// registry caches. A cache with another stamp is still published, the daemon has to be launched
+// to refresh it then.
+class EngineCache
+{
+public:
+    enum State {
+        MISSING, // entries are left alone
+        STALE, // written before engines were installed or removed
+        CURRENT,
+    };
+
+    static QString path(const std::string &addonKey);
+    // FNV-1a of the sizes and modification times of files, missing ones count as well
+    static uint64_t stamp(const QStringList &files);
+
+    static State load(const QString &path,
+                      uint64_t stamp,
+                      const std::string &addonKey,
+                      QList<InputMethodEntry> &entries);
+    static bool save(const QString &path, uint64_t stamp, const QList<InputMethodEntry> &entries);
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !ENGINECACHE_H
@@ -0,0 +1,249 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "EventRecorder.h"
+
+#include "common/common.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace org::deepin::dim;
+
+std::atomic<bool> EventRecorder::enabled_{ false };
+
+namespace {
+
+constexpr char LOG_MAGIC[8] = { 'D', 'I', 'M', 'R', 'E', 'C', '\0', '\0' };
+constexpr uint32_t LOG_VERSION = 2;
+
+struct LogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint64_t textSize; // in bytes, the text follows the records
+};
+
+struct RecordBuffer
+{
+    std::vector<EventRecorder::Record> records;
+    // the slot the next record is written to
+    size_t next = 0;
+    bool wrapped = false;
+
+    // ring of the recorded texts, empty if texts are not recorded
+    std::vector<char> text;
+    // bytes written to the ring so far, a record's textOffset is a position in this stream
+    uint64_t textWritten = 0;
+};
+
+RecordBuffer recordBuffer;
+
+QString envRecordPath;
+
+void dumpAtExit()
+{
+    EventRecorder::dump(envRecordPath);
+}
+
+uint64_t textHash(const char *text, size_t length)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    const auto *bytes = reinterpret_cast<const unsigned char *>(text);
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+} // namespace
+
+void EventRecorder::startFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("DIM_RECORD");
+    if (path.isEmpty() || isEnabled()) {
+        return;
+    }
+
+    envRecordPath = path;
+    start(qEnvironmentVariableIntValue("DIM_RECORD_TEXT") == 1);
+    std::atexit(dumpAtExit);
+}
+
+void EventRecorder::start(bool recordText, size_t capacity, size_t textCapacity)
+{
+    auto &buffer = recordBuffer;
+
+    buffer.records.assign(std::max<size_t>(capacity, 1), Record{});
+    buffer.next = 0;
+    buffer.wrapped = false;
+    buffer.text.assign(recordText ? textCapacity : 0, '\0');
+    buffer.textWritten = 0;
+
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void EventRecorder::stop()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void EventRecorder::append(Type type, uint32_t ic, const Args &args, const QByteArray *text)
+{
+    auto &buffer = recordBuffer;
+
+    Record &record = buffer.records[buffer.next];
+    record = Record{ getMonotonicUs(), ic, type, 0, 0, {}, 0, 0, 0 };
+    std::memcpy(record.args, args.values, sizeof(record.args));
+
+    if (text) {
+        const char *bytes = text->constData();
+        const size_t length = text->size();
+
+        record.textLength = length;
+        record.textHash = textHash(bytes, length);
+
+        // texts longer than the ring are left out
+        const size_t capacity = buffer.text.size();
+        if (length && length <= capacity) {
+            const size_t begin = buffer.textWritten % capacity;
+            const size_t head = std::min(length, capacity - begin);
+            std::memcpy(&buffer.text[begin], bytes, head);
+            std::memcpy(buffer.text.data(), bytes + head, length - head);
+
+            record.flags |= HAS_TEXT;
+            record.textOffset = buffer.textWritten;
+            buffer.textWritten += length;
+        }
+    }
+
+    if (++buffer.next == buffer.records.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+bool EventRecorder::dump(const QString &path)
+{
+    const auto &buffer = recordBuffer;
+
+    const size_t count = buffer.wrapped ? buffer.records.size() : buffer.next;
+    const size_t first = buffer.wrapped ? buffer.next : 0;
+    const size_t capacity = buffer.text.size();
+
+    std::vector<Record> records;
+    std::vector<char> text;
+    records.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        Record record = buffer.records[(first + i) % buffer.records.size()];
+
+        if (record.flags & HAS_TEXT) {
+            // the text may have been overwritten by later texts
+            if (buffer.textWritten - record.textOffset > capacity) {
+                record.flags &= ~HAS_TEXT;
+                record.textOffset = 0;
+            } else {
+                const size_t offset = text.size();
+                for (uint32_t j = 0; j < record.textLength; j++) {
+                    text.push_back(buffer.text[(record.textOffset + j) % capacity]);
+                }
+                record.textOffset = offset;
+            }
+        }
+
+        records.push_back(record);
+    }
+
+    LogHeader header{};
+    std::memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+    header.version = LOG_VERSION;
+    header.recordCount = records.size();
+    header.textSize = text.size();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)
+        || file.write(reinterpret_cast<const char *>(records.data()),
+                      records.size() * sizeof(Record))
+            != qint64(records.size() * sizeof(Record))
+        || file.write(text.data(), text.size()) != qint64(text.size())
+        || !file.commit()) {
+        qWarning() << "failed to write event log to" << path;
+        return false;
+    }
+
+    return true;
+}
+
+bool EventRecorder::load(const QString &path, std::vector<Event> &events)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "failed to open event log" << path;
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+
+    LogHeader header;
+    if (size_t(data.size()) < sizeof(header)) {
+        qWarning() << path << "is not an event log";
+        return false;
+    }
+    std::memcpy(&header, data.constData(), sizeof(header));
+
+    if (std::memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0
+        || header.version != LOG_VERSION
+        || size_t(data.size()) != sizeof(header) + header.recordCount * sizeof(Record)
+                + header.textSize) {
+        qWarning() << path << "is not an event log of version" << LOG_VERSION;
+        return false;
+    }
+
+    const char *recordData = data.constData() + sizeof(header);
+    const char *textData = recordData + header.recordCount * sizeof(Record);
+
+    events.reserve(events.size() + header.recordCount);
+    for (uint32_t i = 0; i < header.recordCount; i++) {
+        Record record;
+        std::memcpy(&record, recordData + i * sizeof(Record), sizeof(record));
+
+        if (record.type > Done) {
+            qWarning() << path << "has an invalid record" << i;
+            return false;
+        }
+
+        Event event{ record.timestampUs,
+                     record.ic,
+                     static_cast<Type>(record.type),
+                     {},
+                     record.textLength,
+                     record.textHash,
+                     false,
+                     {} };
+        std::memcpy(event.args, record.args, sizeof(event.args));
+
+        if (record.flags & HAS_TEXT) {
+            if (record.textOffset + record.textLength > header.textSize) {
+                qWarning() << path << "has an invalid record" << i;
+                return false;
+            }
+
+            event.hasText = true;
+            event.text = QByteArray(textData + record.textOffset, record.textLength);
+        }
+
+        events.emplace_back(std::move(event));
+    }
+
+    return true;
+}
@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+#include <stdint.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Opt-in recorder of the events frontends pass to input contexts, for replaying real typing
+// sessions in dim-bench.
+//
+// Recording is started by setting DIM_RECORD to the path of the log, which is written when dim
+// exits. Events are appended to a preallocated ring buffer, so only the latest events are kept.
+// Texts are only recorded as a hash and a length unless DIM_RECORD_TEXT=1 is set as well.
+// Recording happens on the main thread.
+class EventRecorder
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+    // in bytes
+    static constexpr size_t DEFAULT_TEXT_CAPACITY = 2 * 1024 * 1024;
+
+    enum Type : uint8_t {
+        FocusIn,
+        FocusOut,
+        Key, // args: keysym, keycode, modifiers, release, time
+        Modifiers, // args: depressed, latched, locked, group
+        ContentType, // args: hint, purpose
+        SurroundingText, // args: cursor, anchor
+        Done,
+    };
+
+    enum Flag : uint8_t {
+        HAS_TEXT = 1 << 0,
+    };
+
+    // layout of a record in the log
+    struct Record
+    {
+        uint64_t timestampUs; // getMonotonicUs() when recorded
+        uint32_t ic;
+        uint8_t type;
+        uint8_t flags;
+        uint16_t reserved;
+        uint32_t args[5];
+        uint32_t textLength; // in bytes of UTF-8
+        uint64_t textHash; // FNV-1a of the UTF-8 text
+        uint64_t textOffset; // in the text of the log if flags has HAS_TEXT
+    };
+
+    struct Event
+    {
+        uint64_t timestampUs;
+        uint32_t ic;
+        Type type;
+        uint32_t args[5];
+        uint32_t textLength;
+        uint64_t textHash;
+        bool hasText;
+        QByteArray text; // UTF-8, empty unless hasText
+    };
+
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static void startFromEnvironment();
+    static void start(bool recordText,
+                      size_t capacity = DEFAULT_CAPACITY,
+                      size_t textCapacity = DEFAULT_TEXT_CAPACITY);
+    static void stop();
+    // writes the recorded events to path
+    static bool dump(const QString &path);
+    // reads a log written by dump()
+    static bool load(const QString &path, std::vector<Event> &events);
+
+    static void record(Type type,
+                       uint32_t ic,
+                       uint32_t arg0 = 0,
+                       uint32_t arg1 = 0,
+                       uint32_t arg2 = 0,
+                       uint32_t arg3 = 0,
+                       uint32_t arg4 = 0)
+    {
+        if (isEnabled()) {
+            append(type, ic, { arg0, arg1, arg2, arg3, arg4 }, nullptr);
+        }
+    }
+
+    static void recordSurroundingText(uint32_t ic,
+                                      uint32_t cursor,
+                                      uint32_t anchor,
+                                      const QByteArray &text)
+    {
+        if (isEnabled()) {
+            append(SurroundingText, ic, { cursor, anchor, 0, 0, 0 }, &text);
+        }
+    }
+
+private:
+    struct Args
+    {
+        uint32_t values[5];
+    };
+
+    static void append(Type type, uint32_t ic, const Args &args, const QByteArray *text);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !EVENTRECORDER_H
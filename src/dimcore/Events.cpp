@@ -4,6 +4,8 @@
 
 #include "Events.h"
 
+#include "common/common.h"
+
 using namespace org::deepin::dim;
 
 Event::Event(EventType type)
@@ -30,6 +32,12 @@ InputContextKeyEvent::InputContextKeyEvent(InputContext *ic,
     , isRelease_(isRelease)
     , time_(time)
 {
+    stamp(STAGE_RECEIVED);
+}
+
+void InputContextKeyEvent::stamp(Stage stage)
+{
+    timestamps_[stage] = getMonotonicUs();
 }
 
 InputContextCursorRectChangeEvent::InputContextCursorRectChangeEvent(
@@ -7,6 +7,7 @@
 
 #include <QString>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace org {
@@ -30,6 +31,8 @@ enum class EventType {
     ProxyActiveInputMethodsChanged,
 };
 
+constexpr size_t EVENT_TYPE_CNT = static_cast<size_t>(EventType::ProxyActiveInputMethodsChanged) + 1;
+
 class Event
 {
 public:
@@ -57,6 +60,15 @@ private:
 class InputContextKeyEvent : public InputContextEvent
 {
 public:
+    // points of the key's way through dim, stamped with getMonotonicUs()
+    enum Stage {
+        STAGE_RECEIVED, // the frontend received the key
+        STAGE_DISPATCHED, // Dim passed the key to the input method addon
+        STAGE_HANDLED, // the addon returned
+
+        STAGE_CNT,
+    };
+
     InputContextKeyEvent(InputContext *ic,
                          uint32_t keyVal_,
                          uint32_t keycode,
@@ -76,12 +88,24 @@ public:
 
     inline uint32_t time() const { return time_; }
 
+    inline uint64_t timestamp(Stage stage) const { return timestamps_[stage]; }
+
+    void stamp(Stage stage);
+
+    // the serial a proxy engine got the key with, it forwards the key back with it. 0 if no
+    // proxy engine got the key.
+    inline uint32_t serial() const { return serial_; }
+
+    inline void setSerial(uint32_t serial) { serial_ = serial; }
+
 private:
     uint32_t keySym_;
     uint32_t keycode_;
     uint32_t state_;
     bool isRelease_;
     uint32_t time_;
+    uint32_t serial_ = 0;
+    uint64_t timestamps_[STAGE_CNT] = {};
 };
 
 class InputContextCursorRectChangeEvent : public InputContextEvent
@@ -107,6 +131,41 @@ private:
     ProxyAddon *proxyAddon_;
 };
 
+// The event class carrying the payload of each event type
+template<EventType T>
+struct EventTraits;
+
+#define DIM_EVENT_TRAITS(eventType, eventClass) \
+    template<>                                  \
+    struct EventTraits<eventType>               \
+    {                                           \
+        using type = eventClass;                \
+    };
+
+DIM_EVENT_TRAITS(EventType::InputContextCreated, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextDestroyed, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextFocused, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextUnfocused, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextKeyEvent, InputContextKeyEvent)
+DIM_EVENT_TRAITS(EventType::InputContextCursorRectChanged, InputContextCursorRectChangeEvent)
+DIM_EVENT_TRAITS(EventType::InputContextUpdateContentType, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextUpdateSurroundingText, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::InputContextDone, InputContextEvent)
+DIM_EVENT_TRAITS(EventType::ProxyActiveInputMethodsChanged, ProxyEvent)
+
+#undef DIM_EVENT_TRAITS
+
+template<EventType T>
+using EventClass = typename EventTraits<T>::type;
+
+// Checked downcast of an event to the class of its type
+template<EventType T>
+inline EventClass<T> &event_cast(Event &event)
+{
+    Q_ASSERT(event.type() == T);
+    return static_cast<EventClass<T> &>(event);
+}
+
 } // namespace dim
 } // namespace deepin
 } // namespace org
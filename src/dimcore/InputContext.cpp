@@ -5,14 +5,18 @@
 #include "InputContext.h"
 
 #include "Dim.h"
+#include "EventRecorder.h"
+#include "InputMethodAddon.h"
+#include "ProxyAddon.h"
+#include "common/common.h"
 
 using namespace org::deepin::dim;
 
 InputContext::InputContext(Dim *dim, QObject *parent)
     : QObject(parent)
-    , ObjectId()
     , dim_(dim)
     , inputState_(this)
+    , keyPipeline_([this](uint32_t keycode, bool pressed) { forwardKeyImpl(keycode, pressed); })
 {
     InputContextEvent e(EventType::InputContextCreated, this);
     dim_->postEvent(e);
@@ -30,6 +34,8 @@ void InputContext::focusIn()
 {
     hasFocus_ = true;
 
+    EventRecorder::record(EventRecorder::FocusIn, id());
+
     InputContextEvent e(EventType::InputContextFocused, this);
     dim_->postEvent(e);
 }
@@ -38,6 +44,8 @@ void InputContext::focusOut()
 {
     hasFocus_ = false;
 
+    EventRecorder::record(EventRecorder::FocusOut, id());
+
     InputContextEvent e(EventType::InputContextUnfocused, this);
     dim_->postEvent(e);
 }
@@ -49,27 +57,107 @@ bool InputContext::hasFocus() const
 
 bool InputContext::keyEvent(InputContextKeyEvent &event)
 {
+    EventRecorder::record(EventRecorder::Key,
+                          event.ic()->id(),
+                          event.keySym(),
+                          event.keycode(),
+                          event.state(),
+                          event.isRelease(),
+                          event.time());
+
     return dim_->postEvent(event);
 }
 
+// the late answers of an engine whose keys expired are dropped, see KeyPipeline::expire()
 void InputContext::updatePreedit(const QString &text, int32_t cursorBegin, int32_t cursorEnd)
 {
+    if (keyPipeline_.dropsAnswers()) {
+        return;
+    }
+
     updatePreeditImpl(text, cursorBegin, cursorEnd);
 }
 
 void InputContext::commitString(const QString &text)
 {
+    if (keyPipeline_.dropsAnswers()) {
+        return;
+    }
+
+    commitStringImpl(text);
+}
+
+void InputContext::updatePreedit(std::string_view text, int32_t cursorBegin, int32_t cursorEnd)
+{
+    if (keyPipeline_.dropsAnswers()) {
+        return;
+    }
+
+    updatePreeditImpl(text, cursorBegin, cursorEnd);
+}
+
+void InputContext::commitString(std::string_view text)
+{
+    if (keyPipeline_.dropsAnswers()) {
+        return;
+    }
+
     commitStringImpl(text);
 }
 
+void InputContext::updatePreeditImpl(std::string_view text, int32_t cursorBegin, int32_t cursorEnd)
+{
+    updatePreeditImpl(QString::fromUtf8(text.data(), text.size()), cursorBegin, cursorEnd);
+}
+
+void InputContext::commitStringImpl(std::string_view text)
+{
+    commitStringImpl(QString::fromUtf8(text.data(), text.size()));
+}
+
 void InputContext::commit()
 {
+    if (keyPipeline_.dropsAnswers()) {
+        return;
+    }
+
     commitImpl();
+
+    const uint64_t now = getMonotonicUs();
+    // the engine answers on the channel the keys went through and handles them in order
+    const uint32_t inFlight = keyPipeline_.inFlight();
+    keyPipeline_.settle(now);
+    keyAnswered(inFlight);
+
+    if (pendingKey_.addon) {
+        // the keyboard addon commits before keyEvent() returns
+        const uint64_t handled = pendingKey_.handledUs ? pendingKey_.handledUs : now;
+
+        pendingKey_.addon->keyLatency(InputMethodAddon::KEY_LATENCY_ENGINE).record(now - handled);
+        pendingKey_.addon->keyLatency(InputMethodAddon::KEY_LATENCY_TOTAL)
+            .record(now - pendingKey_.receivedUs);
+        pendingKey_.addon = nullptr;
+    }
 }
 
-void InputContext::forwardKey(uint32_t keycode, bool pressed)
+void InputContext::forwardKey(uint32_t keycode, bool pressed, uint32_t serial)
 {
-    forwardKeyImpl(keycode, pressed);
+    const uint32_t inFlight = keyPipeline_.inFlight();
+    if (!keyPipeline_.forward(serial, keycode, pressed)) {
+        forwardKeyImpl(keycode, pressed);
+    }
+    keyAnswered(inFlight);
+}
+
+void InputContext::keyAnswered(uint32_t inFlight)
+{
+    if (keyPipeline_.inFlight() == inFlight) {
+        return;
+    }
+
+    if (keyProxy_) {
+        keyProxy_->keyAnswered();
+    }
 }
 
 ContentType &InputContext::contentType()
@@ -79,6 +167,11 @@ ContentType &InputContext::contentType()
 
 void InputContext::updateContentType()
 {
+    EventRecorder::record(EventRecorder::ContentType,
+                          id(),
+                          contentType_.hint(),
+                          contentType_.purpose());
+
     InputContextEvent event(EventType::InputContextUpdateContentType, this);
     dim_->postEvent(event);
 }
@@ -90,6 +183,11 @@ SurroundingText &InputContext::surroundingText()
 
 void InputContext::updateSurroundingText()
 {
+    EventRecorder::recordSurroundingText(id(),
+                                         surroundingText_.cursor(),
+                                         surroundingText_.anchor(),
+                                         surroundingText_.text());
+
     InputContextEvent event(EventType::InputContextUpdateSurroundingText, this);
     dim_->postEvent(event);
 }
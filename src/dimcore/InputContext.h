@@ -7,12 +7,14 @@
 
 #include "Events.h"
 #include "InputState.h"
-#include "ObjectId.h"
+#include "KeyPipeline.h"
 #include "SurroundingText.h"
 #include "dimcore/ContentType.h"
 
 #include <QObject>
 
+#include <string>
+#include <string_view>
 #include <variant>
 
 namespace org {
@@ -20,17 +22,28 @@ namespace deepin {
 namespace dim {
 
 class Dim;
+class InputMethodAddon;
+class ProxyAddon;
 
-class InputContext : public QObject, public ObjectId<InputContext>
+class InputContext : public QObject
 {
     Q_OBJECT
     friend class InputState;
+    friend class Dim;
 
 public:
     explicit InputContext(Dim *dim, QObject *parent = nullptr);
     ~InputContext() = default;
 
 public:
+    // handle of the input context in Dim, 0 if Dim couldn't store it. A handle isn't reused
+    // while its input context lives, a kept handle of a destroyed one is detected as stale.
+    uint32_t id() const { return id_; }
+
+    // id of the application owning the input context, empty if it isn't known
+    const std::string &appId() const { return appId_; }
+    void setAppId(const std::string &appId) { appId_ = appId; }
+
     void destroy();
     void focusIn();
     void focusOut();
@@ -38,17 +51,30 @@ public:
 
     InputState &inputState();
 
+    // text may be raw data which is only valid during the call, frontends must not keep it
     void updatePreedit(const QString &text, int32_t cursorBegin, int32_t cursorEnd);
     void commitString(const QString &text);
+    // UTF-8 text, frontends which speak UTF-8 get it without a conversion
+    void updatePreedit(std::string_view text, int32_t cursorBegin, int32_t cursorEnd);
+    void commitString(std::string_view text);
+
+    void updatePreedit(const char *text, int32_t cursorBegin, int32_t cursorEnd)
+    {
+        updatePreedit(std::string_view(text), cursorBegin, cursorEnd);
+    }
+
+    void commitString(const char *text) { commitString(std::string_view(text)); }
+
     void commit();
-    void forwardKey(uint32_t keycode, bool pressed);
+    // serial is the one the engine got the key with, 0 for a key it made up
+    void forwardKey(uint32_t keycode, bool pressed, uint32_t serial = 0);
     ContentType &contentType();
     void updateContentType();
     SurroundingText &surroundingText();
     void updateSurroundingText();
 
 Q_SIGNALS:
-    void imSwitch(const std::pair<std::string, std::string> &imEntry);
+    void imSwitch(InputMethodId im);
 
 protected:
     Dim *dim() { return dim_; }
@@ -57,15 +83,51 @@ protected:
 
     virtual void updatePreeditImpl(const QString &text, int32_t cursorBegin, int32_t cursorEnd) = 0;
     virtual void commitStringImpl(const QString &text) = 0;
+    // convert the text to QString by default
+    virtual void updatePreeditImpl(std::string_view text, int32_t cursorBegin, int32_t cursorEnd);
+    virtual void commitStringImpl(std::string_view text);
     virtual void commitImpl() = 0;
     virtual void forwardKeyImpl(uint32_t keycode, bool pressed) = 0;
 
+private:
+    // the engine answered a key if fewer than inFlight are left
+    void keyAnswered(uint32_t inFlight);
+
 private:
     Dim *dim_;
+    uint32_t id_ = 0;
+    std::string appId_;
     bool hasFocus_ = false;
     InputState inputState_;
     ContentType contentType_;
     SurroundingText surroundingText_;
+
+    // key presses in the proxy engine and the keys queued behind them
+    KeyPipeline keyPipeline_;
+    // the proxy addon the keys in keyPipeline_ were sent to
+    ProxyAddon *keyProxy_ = nullptr;
+
+    // the key press waiting for its commit, for the key latency statistics
+    struct PendingKey
+    {
+        InputMethodAddon *addon;
+        uint64_t receivedUs;
+        uint64_t handledUs; // 0 while the addon is handling the key
+    } pendingKey_ = {};
+
+    // the surrounding text the input method addon has got, it isn't sent again while unchanged
+    struct DeliveredSurroundingText
+    {
+        InputMethodAddon *addon;
+        uint64_t version;
+    } deliveredSurroundingText_ = {};
+
+    // the cursor rectangle the proxy addon has got, repeated rectangles aren't sent again
+    struct DeliveredCursorRect
+    {
+        ProxyAddon *addon;
+        int32_t x, y, w, h;
+    } deliveredCursorRect_ = {};
 };
 
 } // namespace dim
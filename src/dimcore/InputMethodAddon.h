@@ -8,6 +8,7 @@
 #include "Addon.h"
 #include "Events.h"
 #include "InputMethodEntry.h"
+#include "LatencyHistogram.h"
 
 #include <QList>
 
@@ -20,6 +21,16 @@ class InputMethodAddon : public Addon
     Q_OBJECT
 
 public:
+    // latencies of the key events handled by the addon
+    enum KeyLatencyStage {
+        KEY_LATENCY_DISPATCH, // received -> passed to the addon
+        KEY_LATENCY_ADDON, // time spent in keyEvent()
+        KEY_LATENCY_ENGINE, // keyEvent() returned -> commit
+        KEY_LATENCY_TOTAL, // received -> commit
+
+        KEY_LATENCY_STAGE_CNT,
+    };
+
     explicit InputMethodAddon(Dim *dim, const std::string &key, const QString &iconName);
     virtual ~InputMethodAddon();
 
@@ -27,14 +38,25 @@ public:
     virtual void initInputMethods() = 0;
     virtual bool keyEvent(const InputMethodEntry &entry, InputContextKeyEvent &keyEvent) = 0;
     virtual void updateSurroundingText(InputContextEvent &event) = 0;
+    virtual void setCurrentIM(const std::string &im) = 0;
+
+    // Addons with large catalogs only publish the input methods in use in getInputMethods(). All
+    // of them are built here when they are listed, and publishInputMethod() adds one to the
+    // published entries once it's used, returning false if the addon doesn't provide it.
+    virtual QList<InputMethodEntry> availableInputMethods() { return getInputMethods(); }
+
+    virtual bool publishInputMethod([[maybe_unused]] const std::string &name) { return false; }
 
     const QString &iconName() { return iconName_; }
 
+    LatencyHistogram &keyLatency(KeyLatencyStage stage) { return keyLatency_[stage]; }
+
 Q_SIGNALS:
     void addonInitFinished(InputMethodAddon *imAddon);
 
 private:
     const QString iconName_;
+    std::array<LatencyHistogram, KEY_LATENCY_STAGE_CNT> keyLatency_;
 };
 
 } // namespace dim
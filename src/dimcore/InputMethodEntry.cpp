@@ -4,16 +4,9 @@
 
 #include "InputMethodEntry.h"
 
-class InputMethodEntryPrivate
-{
-public:
-    std::string addonKey;
-    std::string uniqueName;
-    std::string name;
-    std::string description;
-    std::string label;
-    std::string iconName;
-};
+#include "StringTable.h"
+
+#include <libintl.h>
 
 using namespace org::deepin::dim;
 
@@ -22,39 +15,52 @@ InputMethodEntry::InputMethodEntry(const std::string &addonKey,
                                    const std::string &name,
                                    const std::string &description,
                                    const std::string &label,
-                                   const std::string &iconName)
-    : d(new InputMethodEntryPrivate{ addonKey, uniqueName, name, description, label, iconName })
+                                   const std::string &iconName,
+                                   const std::string &descriptionDomain)
+    : id_(InputMethodId::get(addonKey, uniqueName))
+    , name_(StringTable::intern(name))
+    , label_(StringTable::intern(label))
+    , iconName_(StringTable::intern(iconName))
+    , description_(StringTable::intern(description))
+    , descriptionDomain_(StringTable::intern(descriptionDomain))
 {
 }
 
-InputMethodEntry::~InputMethodEntry() { }
-
 const std::string &InputMethodEntry::addonKey() const
 {
-    return d->addonKey;
+    return id_.addon();
 }
 
 const std::string &InputMethodEntry::uniqueName() const
 {
-    return d->uniqueName;
+    return id_.name();
 }
 
 const std::string &InputMethodEntry::name() const
 {
-    return d->name;
+    return StringTable::get(name_);
 }
 
 const std::string &InputMethodEntry::description() const
 {
-    return d->description;
+    if (descriptionDomain_ != 0) {
+        // dgettext("") returns the header of the catalog
+        if (description_ != 0) {
+            description_ = StringTable::intern(dgettext(StringTable::get(descriptionDomain_).c_str(),
+                                                        StringTable::get(description_).c_str()));
+        }
+        descriptionDomain_ = 0;
+    }
+
+    return StringTable::get(description_);
 }
 
 const std::string &InputMethodEntry::label() const
 {
-    return d->label;
+    return StringTable::get(label_);
 }
 
 const std::string &InputMethodEntry::iconName() const
 {
-    return d->iconName;
+    return StringTable::get(iconName_);
 }
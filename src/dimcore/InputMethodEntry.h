@@ -5,16 +5,16 @@
 #ifndef INPUTMETHOD_H
 #define INPUTMETHOD_H
 
-#include <QString>
-
-#include <memory>
+#include "InputMethodId.h"
 
-class InputMethodEntryPrivate;
+#include <QString>
 
 namespace org {
 namespace deepin {
 namespace dim {
 
+// Compact record of an input method. The strings are interned in the StringTable, so entries are
+// cheap to copy and can be kept in contiguous tables.
 class InputMethodEntry
 {
 public:
@@ -23,18 +23,38 @@ public:
                      const std::string &name,
                      const std::string &description,
                      const std::string &label,
-                     const std::string &iconName);
-    ~InputMethodEntry();
+                     const std::string &iconName,
+                     const std::string &descriptionDomain = {});
+
+    InputMethodId id() const { return id_; }
 
     const std::string &addonKey() const;
     const std::string &uniqueName() const;
     const std::string &name() const;
+    // translated with the gettext domain passed to the constructor on first access
     const std::string &description() const;
     const std::string &label() const;
     const std::string &iconName() const;
 
+    // compares the interned strings, an entry whose description has been translated differs
+    // from an untranslated copy
+    bool operator==(const InputMethodEntry &other) const
+    {
+        return id_ == other.id_ && name_ == other.name_ && label_ == other.label_
+            && iconName_ == other.iconName_ && description_ == other.description_
+            && descriptionDomain_ == other.descriptionDomain_;
+    }
+
+    bool operator!=(const InputMethodEntry &other) const { return !(*this == other); }
+
 private:
-    std::shared_ptr<InputMethodEntryPrivate> d;
+    InputMethodId id_;
+    uint32_t name_;
+    uint32_t label_;
+    uint32_t iconName_;
+    mutable uint32_t description_;
+    // not 0 until the description has been translated
+    mutable uint32_t descriptionDomain_;
 };
 
 } // namespace dim
@@ -0,0 +1,113 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "InputMethodId.h"
+
+#include "StringTable.h"
+
+#include <QStringList>
+
+#include <unordered_map>
+#include <vector>
+
+using namespace org::deepin::dim;
+
+namespace {
+
+struct IdTable
+{
+    // index 0 is the invalid id
+    std::vector<std::pair<uint32_t, uint32_t>> pairs{ { 0, 0 } };
+    std::unordered_map<uint64_t, uint32_t> ids;
+};
+
+IdTable &idTable()
+{
+    static IdTable table;
+    return table;
+}
+
+uint64_t pairKey(uint32_t addon, uint32_t name)
+{
+    return (uint64_t(addon) << 32) | name;
+}
+
+} // namespace
+
+InputMethodId InputMethodId::get(const std::string &addon, const std::string &name)
+{
+    auto &t = idTable();
+
+    const uint32_t addonStr = StringTable::intern(addon);
+    const uint32_t nameStr = StringTable::intern(name);
+
+    auto [iter, inserted] = t.ids.emplace(pairKey(addonStr, nameStr), t.pairs.size());
+    if (inserted) {
+        t.pairs.emplace_back(addonStr, nameStr);
+    }
+
+    return InputMethodId(iter->second);
+}
+
+InputMethodId InputMethodId::find(const std::string &addon, const std::string &name)
+{
+    const auto &t = idTable();
+
+    uint32_t addonStr, nameStr;
+    if (!StringTable::find(addon, addonStr) || !StringTable::find(name, nameStr)) {
+        return InputMethodId();
+    }
+
+    auto iter = t.ids.find(pairKey(addonStr, nameStr));
+    if (iter == t.ids.end()) {
+        return InputMethodId();
+    }
+
+    return InputMethodId(iter->second);
+}
+
+InputMethodId InputMethodId::fromKey(const QString &key)
+{
+    QStringList keys = key.split(":");
+    if (keys.size() != 2) {
+        return InputMethodId();
+    }
+
+    return get(keys[0].toStdString(), keys[1].toStdString());
+}
+
+uint32_t InputMethodId::maxValue()
+{
+    return idTable().pairs.size() - 1;
+}
+
+const std::string &InputMethodId::addon() const
+{
+    return StringTable::get(idTable().pairs[id_].first);
+}
+
+const std::string &InputMethodId::name() const
+{
+    return StringTable::get(idTable().pairs[id_].second);
+}
+
+QString InputMethodId::toKey() const
+{
+    return QString("%1:%2").arg(QString::fromStdString(addon())).arg(QString::fromStdString(name()));
+}
+
+bool InputMethodId::lessByKey(InputMethodId a, InputMethodId b)
+{
+    if (a.id_ == b.id_) {
+        return false;
+    }
+
+    const auto &[addon1, name1] = idTable().pairs[a.id_];
+    const auto &[addon2, name2] = idTable().pairs[b.id_];
+    if (addon1 != addon2) {
+        return StringTable::get(addon1) < StringTable::get(addon2);
+    }
+
+    return StringTable::get(name1) < StringTable::get(name2);
+}
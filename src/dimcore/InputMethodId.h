@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef INPUTMETHODID_H
+#define INPUTMETHODID_H
+
+#include <QString>
+
+#include <functional>
+#include <set>
+#include <string>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Interned (addon key, unique name) of an input method. Copying and comparing for equality are
+// integer operations, the strings are only needed at the DBus and DConfig edges.
+class InputMethodId
+{
+public:
+    // the invalid id
+    InputMethodId() = default;
+
+    // interns the pair if needed
+    static InputMethodId get(const std::string &addon, const std::string &name);
+    // returns an invalid id if the pair has never been interned
+    static InputMethodId find(const std::string &addon, const std::string &name);
+    // parses a "addon:name" key, returns an invalid id if it is malformed
+    static InputMethodId fromKey(const QString &key);
+
+    // largest id handed out so far, for tables indexed by id
+    static uint32_t maxValue();
+
+    bool isValid() const { return id_ != 0; }
+
+    uint32_t value() const { return id_; }
+
+    const std::string &addon() const;
+    const std::string &name() const;
+    QString toKey() const;
+
+    bool operator==(const InputMethodId &other) const { return id_ == other.id_; }
+
+    bool operator!=(const InputMethodId &other) const { return id_ != other.id_; }
+
+    // Orders by id, i.e. by when the pairs were interned, without touching the strings. The
+    // order differs between runs, it's only for containers whose order isn't shown to the user.
+    bool operator<(const InputMethodId &other) const { return id_ < other.id_; }
+
+    // orders by (addon, name), for lists shown to the user
+    static bool lessByKey(InputMethodId a, InputMethodId b);
+
+    struct KeyLess
+    {
+        bool operator()(InputMethodId a, InputMethodId b) const { return lessByKey(a, b); }
+    };
+
+private:
+    explicit InputMethodId(uint32_t id)
+        : id_(id)
+    {
+    }
+
+private:
+    uint32_t id_ = 0;
+};
+
+// input methods in the order the user switches through them
+using InputMethodIdSet = std::set<InputMethodId, InputMethodId::KeyLess>;
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+template<>
+struct std::hash<org::deepin::dim::InputMethodId>
+{
+    size_t operator()(const org::deepin::dim::InputMethodId &id) const noexcept
+    {
+        return id.value();
+    }
+};
+
+#endif // !INPUTMETHODID_H
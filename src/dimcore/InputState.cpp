@@ -6,6 +6,8 @@
 
 #include "Dim.h"
 #include "InputContext.h"
+#include "InputMethodAddon.h"
+#include "ProxyAddon.h"
 
 #include <QDebug>
 
@@ -13,55 +15,123 @@ using namespace org::deepin::dim;
 
 InputState::InputState(InputContext *ic)
     : ic_(ic)
-    , currentIMKey_(ic->dim_->getCurrentActiveInputMethod())
+    , currentIM_(ic->dim_->getCurrentActiveInputMethod())
+    , validatedEpoch_(ic->dim_->activeIMEntriesEpoch())
 {
-    connect(ic_->dim_, &Dim::inputMethodEntryChanged, this, [this]() {
-        auto iter = findIMEntry();
-        currentIMKey_ = *iter;
-    });
+}
+
+void InputState::revalidate()
+{
+    const uint64_t epoch = ic_->dim_->activeIMEntriesEpoch();
+    if (validatedEpoch_ == epoch) {
+        return;
+    }
+
+    validatedEpoch_ = epoch;
+
+    auto iter = findIMEntry();
+    if (iter != ic_->dim_->activeInputMethodEntries().cend() && *iter != currentIM_) {
+        setCurrentIM(*iter);
+    }
+}
+
+const InputMethodEntry *InputState::resolvedIMEntry()
+{
+    if (resolvedSerial_ != ic_->dim_->imEntriesSerial()) {
+        resolve();
+    }
+
+    return resolvedEntry_;
+}
+
+InputMethodAddon *InputState::resolvedIMAddon()
+{
+    if (resolvedSerial_ != ic_->dim_->imEntriesSerial()) {
+        resolve();
+    }
+
+    return resolvedAddon_;
+}
+
+ProxyAddon *InputState::resolvedProxyAddon()
+{
+    if (resolvedSerial_ != ic_->dim_->imEntriesSerial()) {
+        resolve();
+    }
+
+    return resolvedProxy_;
+}
+
+void InputState::setCurrentIM(InputMethodId im)
+{
+    currentIM_ = im;
+    resolve();
+}
+
+void InputState::resolve()
+{
+    const auto *dim = ic_->dim_;
+
+    resolvedSerial_ = dim->imEntriesSerial();
+    resolvedEntry_ = dim->findIMEntry(currentIM_);
+    resolvedAddon_ = nullptr;
+    resolvedProxy_ = nullptr;
+
+    auto iter = dim->addons().find(currentIM_.addon());
+    if (iter != dim->addons().end()) {
+        resolvedAddon_ = qobject_cast<InputMethodAddon *>(iter->second);
+    }
+
+    for (auto *proxyAddon : dim->proxyAddons()) {
+        if (proxyAddon == resolvedAddon_) {
+            resolvedProxy_ = proxyAddon;
+            break;
+        }
+    }
 }
 
 void InputState::switchIM()
 {
+    const auto &imList = ic_->dim_->activeInputMethodEntries();
+    if (imList.empty()) {
+        return;
+    }
+
     auto iter = findIMEntry();
     iter++;
 
-    const auto &imList = ic_->dim_->activeInputMethodEntries();
     if (iter == imList.cend()) {
         iter = imList.cbegin();
     }
 
-    currentIMKey_ = *iter;
-    emit ic_->imSwitch(currentIMKey_);
+    setCurrentIM(*iter);
+    emit ic_->imSwitch(currentIM_);
 }
 
-void InputState::requestSwitchIM(const std::string &framework, const std::string &name)
+void InputState::requestSwitchIM(InputMethodId im)
 {
-    const auto &activeInputMethodEntries = ic_->dim_->activeInputMethodEntries();
+    if (!ic_->dim_->activeInputMethodEntries().count(im)) {
+        return;
+    }
 
-    auto iter = std::find_if(activeInputMethodEntries.cbegin(),
-                             activeInputMethodEntries.cend(),
-                             [this, &framework, &name](const auto &pair) {
-                                 return pair.first == framework && pair.second == name;
-                             });
-    if (iter == activeInputMethodEntries.cend()) {
+    setCurrentIM(im);
+    emit ic_->imSwitch(currentIM_);
+}
+
+void InputState::restoreIM(InputMethodId im)
+{
+    if (!ic_->dim_->activeInputMethodEntries().count(im)) {
         return;
     }
 
-    currentIMKey_ = *iter;
-    emit ic_->imSwitch(currentIMKey_);
+    setCurrentIM(im);
 }
 
-std::set<std::pair<std::string, std::string>>::const_iterator InputState::findIMEntry() const
+InputMethodIdSet::const_iterator InputState::findIMEntry() const
 {
     const auto &activeInputMethodEntries = ic_->dim_->activeInputMethodEntries();
 
-    auto iter = std::find_if(activeInputMethodEntries.cbegin(),
-                             activeInputMethodEntries.cend(),
-                             [this](const auto &pair) {
-                                 return pair.first == currentIMKey_.first
-                                     && pair.second == currentIMKey_.second;
-                             });
+    auto iter = activeInputMethodEntries.find(currentIM_);
     if (iter == activeInputMethodEntries.cend()) {
         iter = activeInputMethodEntries.cbegin();
     }
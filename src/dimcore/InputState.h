@@ -7,9 +7,8 @@
 
 #include "InputMethodEntry.h"
 
-#include <QObject>
-
 #include <set>
+#include <vector>
 
 namespace org {
 namespace deepin {
@@ -17,28 +16,57 @@ namespace dim {
 
 class Dim;
 class InputContext;
+class InputMethodAddon;
 class InputMethodEntry;
+class ProxyAddon;
 
-class InputState : public QObject
+class InputState
 {
-    Q_OBJECT
+    friend class Dim;
 
 public:
     explicit InputState(InputContext *ic);
 
-    const auto &currentIMEntry() const { return currentIMKey_; }
+    InputMethodId currentIMEntry() const { return currentIM_; }
 
-    void switchIM();
+    // entry and addon of the current input method, nullptr if it is not available
+    const InputMethodEntry *resolvedIMEntry();
+    InputMethodAddon *resolvedIMAddon();
+    // the current input method's addon if it is a proxy addon
+    ProxyAddon *resolvedProxyAddon();
 
-public Q_SLOTS:
-    void requestSwitchIM(const std::string &framework, const std::string &name);
+    void switchIM();
+    void requestSwitchIM(InputMethodId im);
+    // sets the input method of an input context rebuilt from saved state, without switching the
+    // addons, im is ignored if it isn't active anymore
+    void restoreIM(InputMethodId im);
 
 private:
-    std::set<std::pair<std::string, std::string>>::const_iterator findIMEntry() const;
+    InputMethodIdSet::const_iterator findIMEntry() const;
+    // falls back to the first active input method if the current one has been removed since the
+    // last validation, called by Dim before a key or focus event
+    void revalidate();
+    void setCurrentIM(InputMethodId im);
+    void resolve();
 
 private:
-    std::pair<std::string, std::string> currentIMKey_;
+    InputMethodId currentIM_;
     InputContext *ic_;
+    // the Dim::activeIMEntriesEpoch() currentIM_ has been validated against
+    uint64_t validatedEpoch_;
+    // resolved from currentIM_ against the entries of this serial
+    uint64_t resolvedSerial_ = 0;
+    const InputMethodEntry *resolvedEntry_ = nullptr;
+    InputMethodAddon *resolvedAddon_ = nullptr;
+    ProxyAddon *resolvedProxy_ = nullptr;
+
+    // routing state of the input context, maintained by Dim
+    // the proxy addon which has been told that the input context is focused
+    ProxyAddon *focusedProxy_ = nullptr;
+    // the proxy addon which lost the focus and hasn't got a done() yet
+    ProxyAddon *unfocusedProxy_ = nullptr;
+    // the proxy addons which have seen the input context and must be told when it's destroyed
+    std::vector<ProxyAddon *> seenProxies_;
 };
 
 } // namespace dim
@@ -0,0 +1,222 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "KeyPipeline.h"
+
+using namespace org::deepin::dim;
+
+KeyPipeline::KeyPipeline(Release release)
+    : release_(std::move(release))
+{
+}
+
+void KeyPipeline::send(uint32_t serial, uint32_t keycode, bool pressed, uint64_t sentUs)
+{
+    if (serial) {
+        lastSerial_ = serial;
+    }
+
+    if (!pressed) {
+        // only kept to follow its press if that expires
+        if (!empty()) {
+            push(serial, keycode, pressed, sentUs, SENT);
+        }
+        return;
+    }
+
+    if (keycode < KEYCODE_CNT) {
+        passed_.reset(keycode);
+    }
+
+    if (inFlight_ == WINDOW) {
+        for (uint64_t seq = head_; seq < tail_; seq++) {
+            if (at(seq).state == IN_FLIGHT) {
+                retire(seq, CONSUMED);
+                break;
+            }
+        }
+        drain();
+    }
+
+    push(serial, keycode, pressed, sentUs, IN_FLIGHT);
+    inFlight_++;
+}
+
+bool KeyPipeline::pass(uint32_t keycode, bool pressed)
+{
+    if (empty()) {
+        return false;
+    }
+
+    push(0, keycode, pressed, 0, PASS);
+
+    return true;
+}
+
+bool KeyPipeline::forward(uint32_t serial, uint32_t keycode, bool pressed)
+{
+    // serials grow, the engine is past the expired keys once it answers a later one
+    if (dropsAnswers_ && serial && static_cast<int32_t>(serial - expiredSerial_) > 0) {
+        dropsAnswers_ = false;
+    }
+
+    for (uint64_t seq = head_; serial && seq < tail_; seq++) {
+        const auto &key = at(seq);
+        if (key.serial != serial || (key.state != IN_FLIGHT && key.state != SENT)) {
+            continue;
+        }
+
+        // the engine is done with the keys sent before
+        for (uint64_t prev = head_; prev < seq; prev++) {
+            if (at(prev).state == IN_FLIGHT) {
+                retire(prev, CONSUMED);
+            }
+        }
+
+        if (key.keycode == keycode && key.pressed == pressed) {
+            retire(seq, PASS);
+            drain();
+
+            return true;
+        }
+
+        // made up by the engine while it handles the key, which stays in flight
+        drain();
+        break;
+    }
+
+    // a late answer to a key the application already got
+    if (dropsAnswers() || (keycode < KEYCODE_CNT && passed_.test(keycode))) {
+        return true;
+    }
+
+    // not sent by dim, still kept behind the queued keys
+    return pass(keycode, pressed);
+}
+
+void KeyPipeline::flush()
+{
+    for (uint64_t seq = head_; seq < tail_; seq++) {
+        if (at(seq).state == IN_FLIGHT) {
+            retire(seq, CONSUMED);
+        }
+    }
+    drain();
+
+    dropsAnswers_ = false;
+}
+
+void KeyPipeline::settle(uint64_t beforeUs)
+{
+    for (uint64_t seq = head_; seq < tail_; seq++) {
+        auto &key = at(seq);
+        if (key.state != IN_FLIGHT) {
+            continue;
+        }
+        // keys are sent in order
+        if (key.sentUs >= beforeUs) {
+            break;
+        }
+
+        retire(seq, CONSUMED);
+    }
+    drain();
+}
+
+uint32_t KeyPipeline::expire(uint64_t beforeUs,
+                             const std::function<void(uint32_t keycode)> &releaseInEngine)
+{
+    uint32_t expired = 0;
+    for (uint64_t seq = head_; seq < tail_; seq++) {
+        auto &key = at(seq);
+        if (key.state != IN_FLIGHT) {
+            continue;
+        }
+        // keys are sent in order
+        if (key.sentUs >= beforeUs) {
+            break;
+        }
+
+        retire(seq, PASS);
+        expired++;
+
+        // the release sent to the engine meanwhile, or the one still to come
+        bool released = false;
+        for (uint64_t next = seq + 1; next < tail_; next++) {
+            auto &release = at(next);
+            if (release.state == SENT && release.keycode == key.keycode) {
+                release.state = PASS;
+                released = true;
+                break;
+            }
+        }
+        if (key.keycode < KEYCODE_CNT) {
+            passed_.set(key.keycode, !released);
+        }
+        if (!released) {
+            releaseInEngine(key.keycode);
+        }
+    }
+
+    drain();
+
+    if (expired) {
+        dropsAnswers_ = true;
+        expiredSerial_ = lastSerial_;
+    }
+
+    return expired;
+}
+
+bool KeyPipeline::takePassed(uint32_t keycode)
+{
+    if (keycode >= KEYCODE_CNT || !passed_.test(keycode)) {
+        return false;
+    }
+
+    passed_.reset(keycode);
+
+    return true;
+}
+
+uint64_t KeyPipeline::push(
+    uint32_t serial, uint32_t keycode, bool pressed, uint64_t sentUs, State state)
+{
+    // a full queue releases its oldest key, the window keeps the keys in flight below CAPACITY
+    if (tail_ - head_ == CAPACITY) {
+        auto &oldest = at(head_);
+        if (oldest.state == IN_FLIGHT) {
+            retire(head_, CONSUMED);
+        }
+        drain();
+    }
+
+    at(tail_) = Key{ sentUs, serial, keycode, pressed, state };
+
+    return tail_++;
+}
+
+void KeyPipeline::retire(uint64_t seq, State state)
+{
+    auto &key = at(seq);
+    if (key.state == IN_FLIGHT) {
+        inFlight_--;
+    }
+    key.state = state;
+}
+
+void KeyPipeline::drain()
+{
+    while (!empty()) {
+        auto &key = at(head_);
+        if (key.state == IN_FLIGHT) {
+            break;
+        }
+
+        head_++;
+        if (key.state == PASS) {
+            release_(key.keycode, key.pressed);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef KEYPIPELINE_H
+#define KEYPIPELINE_H
+
+#include <array>
+#include <bitset>
+#include <functional>
+
+#include <stdint.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Ordered pipeline of the keys of an input context which went to a proxy engine.
+//
+// A proxy sends a key to its engine with a serial and returns at once, the engine answers later
+// on the same connection with a commit, a preedit or the key forwarded back with its serial. Keys
+// the engine doesn't see, e.g. while its daemon isn't focused, would overtake the keys still in
+// the engine, so they are queued behind them. Engines handle keys in order: a forwarded key
+// retires the keys sent before it, a commit or a preedit the presses sent before it arrived. A
+// press it retires which the engine forwards after all still goes to the application. Keys leave
+// the pipeline to the application in the order they were received. At most WINDOW keys are in
+// flight, older ones are taken as consumed.
+//
+// A press the engine doesn't answer by its deadline goes to the application past the engine, so
+// a hung engine can't hold the keys back. Its release follows it there, and the late answers of
+// the engine are dropped until it answers a key sent after them.
+class KeyPipeline
+{
+public:
+    static constexpr uint32_t WINDOW = 32;
+
+    // passes a key to the application
+    using Release = std::function<void(uint32_t keycode, bool pressed)>;
+
+    explicit KeyPipeline(Release release);
+
+    bool empty() const { return head_ == tail_; }
+
+    uint32_t inFlight() const { return inFlight_; }
+
+    // a key sent to the engine with serial at sentUs, only key presses wait for an answer
+    void send(uint32_t serial, uint32_t keycode, bool pressed, uint64_t sentUs);
+    // A key for the application. Returns false if nothing is queued, the caller passes the key
+    // itself then.
+    bool pass(uint32_t keycode, bool pressed);
+    // The engine forwarded a key with the serial of the key it was handling, 0 if it has none.
+    // A key it made up rather than got from dim is handled like pass().
+    bool forward(uint32_t serial, uint32_t keycode, bool pressed);
+    // the engine lost the focus, the keys in flight are taken as consumed
+    void flush();
+    // the engine answered after the keys sent before beforeUs, the presses of them in flight were
+    // swallowed
+    void settle(uint64_t beforeUs);
+
+    // when the oldest key in flight was sent, inFlight() must not be 0
+    uint64_t oldestSentUs() const { return keys_[head_ % CAPACITY].sentUs; }
+
+    // Passes the key presses in flight sent before beforeUs to the application, returns how many
+    // there were. releaseInEngine is called for the ones whose release the engine hasn't got, so
+    // the engine doesn't take the key as held.
+    uint32_t expire(uint64_t beforeUs,
+                    const std::function<void(uint32_t keycode)> &releaseInEngine);
+    // True while the engine may still answer keys which expired, until it forwards a key sent
+    // after them. Its commits and preedits are dropped meanwhile.
+    bool dropsAnswers() const { return dropsAnswers_; }
+    // True if the press of keycode went to the application past the engine, its release has to
+    // follow it. Clears the mark.
+    bool takePassed(uint32_t keycode);
+
+private:
+    enum State : uint8_t {
+        IN_FLIGHT,
+        CONSUMED,
+        // a key release the engine got, it doesn't wait for an answer
+        SENT,
+        // released to the application when it reaches the front
+        PASS,
+    };
+
+    struct Key
+    {
+        uint64_t sentUs;
+        uint32_t serial;
+        uint32_t keycode;
+        bool pressed;
+        State state;
+    };
+
+    // twice the window, so keys queued behind a full window fit
+    static constexpr uint32_t CAPACITY = WINDOW * 2;
+    // evdev key codes
+    static constexpr uint32_t KEYCODE_CNT = 0x300;
+
+    Key &at(uint64_t seq) { return keys_[seq % CAPACITY]; }
+
+    uint64_t push(uint32_t serial, uint32_t keycode, bool pressed, uint64_t sentUs, State state);
+    void retire(uint64_t seq, State state);
+    void drain();
+
+private:
+    Release release_;
+    std::array<Key, CAPACITY> keys_;
+    // sequence numbers of the oldest key and of the next key
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+    uint32_t inFlight_ = 0;
+    // key presses which were passed past the engine
+    std::bitset<KEYCODE_CNT> passed_;
+    // serial of the last key sent, and of the last key sent before keys expired
+    uint32_t lastSerial_ = 0;
+    uint32_t expiredSerial_ = 0;
+    bool dropsAnswers_ = false;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !KEYPIPELINE_H
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+using namespace org::deepin::dim;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+uint32_t LatencyHistogram::bucketIndex(uint64_t us)
+{
+    if (us < SUB_BUCKET_CNT) {
+        return us;
+    }
+
+    const uint32_t exp = 63 - __builtin_clzll(us);
+    const uint32_t sub = (us >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKET_CNT - 1);
+
+    return (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKET_CNT + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(uint32_t index)
+{
+    if (index < SUB_BUCKET_CNT) {
+        return index;
+    }
+
+    const uint32_t exp = index / SUB_BUCKET_CNT + SUB_BUCKET_BITS - 1;
+    const uint64_t sub = index % SUB_BUCKET_CNT;
+    const uint32_t shift = exp - SUB_BUCKET_BITS;
+
+    // the last bucket would overflow
+    if (exp == 63 && sub == SUB_BUCKET_CNT - 1) {
+        return UINT64_MAX;
+    }
+
+    return ((SUB_BUCKET_CNT + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us)
+{
+    buckets_[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (us > max && !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) { }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    std::array<uint64_t, BUCKET_CNT> buckets;
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < BUCKET_CNT; i++) {
+        buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    const uint64_t max = max_.load(std::memory_order_relaxed);
+
+    return Snapshot{
+        count,
+        percentile(buckets, count, max, 500),
+        percentile(buckets, count, max, 990),
+        max,
+    };
+}
+
+uint64_t LatencyHistogram::percentile(const std::array<uint64_t, BUCKET_CNT> &buckets,
+                                      uint64_t count,
+                                      uint64_t max,
+                                      uint32_t permille) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // rank of the sample, 1-based
+    const uint64_t rank = (count * permille + 999) / 1000;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_CNT; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+
+    return max;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+
+#include <stdint.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Lock-free histogram of latencies in microseconds.
+//
+// Buckets are log-linear: each power of two is split into 4 buckets, so a percentile is reported
+// with an error of at most 25%. Recording is a few relaxed atomic operations, a snapshot may run
+// concurrently with recording.
+class LatencyHistogram
+{
+public:
+    struct Snapshot
+    {
+        uint64_t count;
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    LatencyHistogram();
+
+    void record(uint64_t us);
+    Snapshot snapshot() const;
+    void reset();
+
+private:
+    static constexpr uint32_t SUB_BUCKET_BITS = 2;
+    static constexpr uint32_t SUB_BUCKET_CNT = 1 << SUB_BUCKET_BITS;
+    static constexpr uint32_t BUCKET_CNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_CNT;
+
+    static uint32_t bucketIndex(uint64_t us);
+    static uint64_t bucketUpperBound(uint32_t index);
+
+    uint64_t percentile(const std::array<uint64_t, BUCKET_CNT> &buckets,
+                        uint64_t count,
+                        uint64_t max,
+                        uint32_t permille) const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_CNT> buckets_;
+    std::atomic<uint64_t> max_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !LATENCYHISTOGRAM_H
@@ -5,8 +5,12 @@
 #include "ProxyAddon.h"
 
 #include "Dim.h"
+#include "common/common.h"
 
+#include <QDebug>
+#include <QProcess>
 #include <QStandardPaths>
+#include <QTimer>
 
 using namespace org::deepin::dim;
 
@@ -25,7 +29,64 @@ void ProxyAddon::updateActiveInputMethods(const std::vector<std::string> &value)
     dim()->postEvent(event);
 }
 
+void ProxyAddon::requestDaemon()
+{
+    daemonUsedUs_ = getMonotonicUs();
+
+    if (daemonRequested_) {
+        return;
+    }
+
+    daemonRequested_ = true;
+    launchDaemon();
+}
+
+void ProxyAddon::reapDaemon(uint64_t idleSinceUs)
+{
+    if (!daemonRequested_ || daemonUsedUs_ >= idleSinceUs) {
+        return;
+    }
+
+    qInfo() << "stopping the idle engine daemon of" << key().c_str();
+
+    daemonRequested_ = false;
+    stopDaemon();
+}
+
+void ProxyAddon::stopProcess(QProcess *process)
+{
+    // the daemon exits on its own time rather than being killed along with the addon
+    process->setParent(nullptr);
+
+    if (process->state() == QProcess::NotRunning) {
+        process->deleteLater();
+        return;
+    }
+
+    connect(process,
+            QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            process,
+            &QObject::deleteLater);
+    QTimer::singleShot(DAEMON_KILL_TIMEOUT, process, &QProcess::kill);
+    process->terminate();
+}
+
 bool ProxyAddon::isExecutableExisted(const QString &name)
 {
     return !QStandardPaths::findExecutable(name, QStringList()).isEmpty();
 }
+
+void ProxyAddon::keyMissed(uint64_t nowUs)
+{
+    if (++missedKeys_ < MISSED_KEYS_LIMIT) {
+        return;
+    }
+
+    if (!isDegraded(nowUs)) {
+        qWarning() << "engine of" << key().c_str() << "stopped answering keys, bypassing it";
+    }
+
+    degradedUntilUs_ = nowUs + DEGRADED_US;
+    // a single miss after the bypass degrades the engine again
+    missedKeys_ = MISSED_KEYS_LIMIT - 1;
+}
@@ -7,6 +7,8 @@
 
 #include "InputMethodAddon.h"
 
+class QProcess;
+
 namespace org {
 namespace deepin {
 namespace dim {
@@ -30,15 +32,44 @@ public:
     virtual void done() = 0;
     virtual void contentType(uint32_t hint, uint32_t purpose) = 0;
     virtual void cursorRectangleChangeEvent(InputContextCursorRectChangeEvent &event) = 0;
-    virtual void setCurrentIM(const std::string &im) = 0;
 
     static bool isExecutableExisted(const QString &name);
 
+    // Launches the engine daemon unless it's running. Dim asks for it once an input method of the
+    // addon is active or about to be used, until then the input methods come from EngineCache.
+    void requestDaemon();
+    // stops the daemon if it hasn't been asked for since idleSinceUs
+    void reapDaemon(uint64_t idleSinceUs);
+
+    // The engine let a key pass its deadline. After MISSED_KEYS_LIMIT keys in a row it's
+    // degraded, keys bypass it for DEGRADED_US and then it's tried again.
+    void keyMissed(uint64_t nowUs);
+    void keyAnswered() { missedKeys_ = 0; }
+    bool isDegraded(uint64_t nowUs) const { return nowUs < degradedUntilUs_; }
+
+    // sends the release of keycode to the engine, which won't get the one of a press passed past it
+    virtual void releaseKey(uint32_t id, uint32_t keycode) = 0;
+
 protected:
     void updateActiveInputMethods(const std::vector<std::string> &value);
 
+    virtual void launchDaemon() = 0;
+    virtual void stopDaemon() = 0;
+    // Terminates process without waiting for it and deletes it once it has finished. It's
+    // killed if it's still running after DAEMON_KILL_TIMEOUT.
+    static void stopProcess(QProcess *process);
+
 private:
+    static constexpr uint32_t MISSED_KEYS_LIMIT = 3;
+    static constexpr uint64_t DEGRADED_US = 2000000;
+    // milliseconds
+    static constexpr int DAEMON_KILL_TIMEOUT = 5000;
+
     std::vector<std::string> activeInputMethods_;
+    uint32_t missedKeys_ = 0;
+    uint64_t degradedUntilUs_ = 0;
+    bool daemonRequested_ = false;
+    uint64_t daemonUsedUs_ = 0;
 };
 
 } // namespace dim
@@ -0,0 +1,155 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Dense storage addressed by generational handles.
+//
+// A handle packs the index of a slot and the generation of the slot. Erasing a value bumps the
+// generation of its slot, so a handle kept after the erase is detected as stale even when the
+// slot has been reused. Lookup is O(1) and the values are iterated as a dense array, in no
+// particular order. Handle 0 is never returned.
+template<typename T>
+class SlotMap
+{
+public:
+    using Handle = uint32_t;
+
+    static constexpr Handle INVALID_HANDLE = 0;
+    static constexpr uint32_t INDEX_BITS = 16;
+    static constexpr uint32_t MAX_SIZE = (1 << INDEX_BITS) - 1;
+
+    // returns INVALID_HANDLE if the map is full
+    Handle insert(T value)
+    {
+        uint32_t index;
+        if (freeHead_ != NONE) {
+            index = freeHead_;
+            freeHead_ = slots_[index].dense;
+        } else {
+            if (slots_.size() == MAX_SIZE) {
+                return INVALID_HANDLE;
+            }
+            index = slots_.size();
+            slots_.push_back(Slot{ 1, NONE });
+        }
+
+        auto &slot = slots_[index];
+        slot.dense = values_.size();
+        values_.push_back(std::move(value));
+        denseSlots_.push_back(index);
+
+        return makeHandle(index, slot.generation);
+    }
+
+    bool erase(Handle handle)
+    {
+        if (!find(handle)) {
+            return false;
+        }
+
+        const uint32_t index = handleIndex(handle);
+        auto &slot = slots_[index];
+
+        // move the last value into the hole
+        const uint32_t last = values_.size() - 1;
+        if (slot.dense != last) {
+            values_[slot.dense] = std::move(values_[last]);
+            denseSlots_[slot.dense] = denseSlots_[last];
+            slots_[denseSlots_[slot.dense]].dense = slot.dense;
+        }
+        values_.pop_back();
+        denseSlots_.pop_back();
+
+        // generation 0 would make handle 0 valid
+        slot.generation = (slot.generation + 1) & GENERATION_MASK;
+        if (slot.generation == 0) {
+            slot.generation = 1;
+        }
+        slot.dense = freeHead_;
+        freeHead_ = index;
+
+        return true;
+    }
+
+    // nullptr if handle is stale
+    T *find(Handle handle)
+    {
+        return const_cast<T *>(static_cast<const SlotMap *>(this)->find(handle));
+    }
+
+    const T *find(Handle handle) const
+    {
+        const uint32_t index = handleIndex(handle);
+        if (index >= slots_.size()) {
+            return nullptr;
+        }
+
+        const auto &slot = slots_[index];
+        if (slot.generation != handleGeneration(handle) || slot.dense >= values_.size()
+            || denseSlots_[slot.dense] != index) {
+            return nullptr;
+        }
+
+        return &values_[slot.dense];
+    }
+
+    bool contains(Handle handle) const { return find(handle) != nullptr; }
+
+    size_t size() const { return values_.size(); }
+
+    bool empty() const { return values_.empty(); }
+
+    auto begin() { return values_.begin(); }
+
+    auto end() { return values_.end(); }
+
+    auto begin() const { return values_.cbegin(); }
+
+    auto end() const { return values_.cend(); }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t INDEX_MASK = (1 << INDEX_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = UINT32_MAX >> INDEX_BITS;
+
+    struct Slot
+    {
+        uint32_t generation;
+        // index in values_ while the slot is used, the next free slot otherwise
+        uint32_t dense;
+    };
+
+    static Handle makeHandle(uint32_t index, uint32_t generation)
+    {
+        return (generation << INDEX_BITS) | index;
+    }
+
+    static uint32_t handleIndex(Handle handle) { return handle & INDEX_MASK; }
+
+    static uint32_t handleGeneration(Handle handle) { return handle >> INDEX_BITS; }
+
+    std::vector<Slot> slots_;
+    std::vector<T> values_;
+    // the slot of each value
+    std::vector<uint32_t> denseSlots_;
+    uint32_t freeHead_ = NONE;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !SLOTMAP_H
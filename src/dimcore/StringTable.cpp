@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "StringTable.h"
+
+#include <deque>
+#include <unordered_map>
+
+using namespace org::deepin::dim;
+
+namespace {
+
+struct Table
+{
+    Table()
+    {
+        strings.emplace_back();
+        ids.emplace(strings.back(), 0);
+    }
+
+    // a deque never moves its elements, so the views in ids stay valid
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+Table &table()
+{
+    static Table table;
+    return table;
+}
+
+} // namespace
+
+uint32_t StringTable::intern(std::string_view str)
+{
+    auto &t = table();
+
+    auto iter = t.ids.find(str);
+    if (iter != t.ids.end()) {
+        return iter->second;
+    }
+
+    uint32_t id = t.strings.size();
+    t.strings.emplace_back(str);
+    t.ids.emplace(t.strings.back(), id);
+
+    return id;
+}
+
+bool StringTable::find(std::string_view str, uint32_t &id)
+{
+    auto &t = table();
+
+    auto iter = t.ids.find(str);
+    if (iter == t.ids.end()) {
+        return false;
+    }
+
+    id = iter->second;
+    return true;
+}
+
+const std::string &StringTable::get(uint32_t id)
+{
+    auto &t = table();
+
+    return id < t.strings.size() ? t.strings[id] : t.strings[0];
+}
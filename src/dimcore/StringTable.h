@@ -0,0 +1,31 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef STRINGTABLE_H
+#define STRINGTABLE_H
+
+#include <string>
+#include <string_view>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Process-wide table of interned strings. Ids are never released, so references returned by get()
+// stay valid for the lifetime of the process. Id 0 is the empty string.
+// Not thread-safe, only used from the main thread.
+class StringTable
+{
+public:
+    static uint32_t intern(std::string_view str);
+    // returns false if str has not been interned
+    static bool find(std::string_view str, uint32_t &id);
+    static const std::string &get(uint32_t id);
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#endif // !STRINGTABLE_H
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SurroundingText.h"
+
+#include <cstring>
+
+using namespace org::deepin::dim;
+
+void SurroundingText::setText(std::string_view text)
+{
+    replaceText(nullptr, text);
+}
+
+void SurroundingText::setCursor(uint32_t cursor)
+{
+    if (cursor_ != cursor) {
+        cursor_ = cursor;
+        version_++;
+    }
+}
+
+void SurroundingText::setAnchor(uint32_t anchor)
+{
+    if (anchor_ != anchor) {
+        anchor_ = anchor;
+        version_++;
+    }
+}
+
+void SurroundingText::update(const SurroundingText &other)
+{
+    if (text_.constData() != other.text_.constData()) {
+        replaceText(&other.text_, std::string_view(other.text_.constData(), other.text_.size()));
+    }
+
+    setCursor(other.cursor_);
+    setAnchor(other.anchor_);
+}
+
+void SurroundingText::replaceText(const QByteArray *shared, std::string_view text)
+{
+    if (std::string_view(text_.constData(), text_.size()) == text) {
+        return;
+    }
+
+    if (shared) {
+        text_ = *shared;
+    } else {
+        // keeps the buffer if it isn't shared
+        text_.resize(text.size());
+        std::memcpy(text_.data(), text.data(), text.size());
+    }
+
+    version_++;
+}
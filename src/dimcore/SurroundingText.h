@@ -5,32 +5,52 @@
 #ifndef SURROUDINGTEXT_H
 #define SURROUDINGTEXT_H
 
-#include <QString>
+#include <QByteArray>
+
+#include <string_view>
 
 namespace org::deepin::dim {
 
+// Surrounding text of an input context.
+//
+// The text is UTF-8 as the Wayland protocols send it, cursor and anchor are byte offsets. The
+// buffer is implicitly shared, so copying the text between input contexts doesn't copy it.
+// Setting an unchanged text is detected and keeps the version, so that addons can skip unchanged
+// text.
 class SurroundingText
 {
 public:
     SurroundingText() = default;
     ~SurroundingText() = default;
 
-    const QString &text() { return text_; }
+    // NUL-terminated
+    const QByteArray &text() const { return text_; }
+
+    void setText(std::string_view text);
+
+    uint32_t cursor() const { return cursor_; }
 
-    void setText(const QString &text) { text_ = text; }
+    void setCursor(uint32_t cursor);
 
-    uint32_t cursor() { return cursor_; }
+    uint32_t anchor() const { return anchor_; }
 
-    void setCursor(uint32_t cursor) { cursor_ = cursor; }
+    void setAnchor(uint32_t anchor);
 
-    uint32_t anchor() { return anchor_; }
+    // takes the text, cursor and anchor of other, the text is shared
+    void update(const SurroundingText &other);
 
-    void setAnchor(uint32_t anchor) { anchor_ = anchor; }
+    // changes whenever the text, the cursor or the anchor changes
+    uint64_t version() const { return version_; }
 
 private:
-    QString text_;
+    void replaceText(const QByteArray *shared, std::string_view text);
+
+private:
+    QByteArray text_;
     uint32_t cursor_ = 0;
     uint32_t anchor_ = 0;
+
+    uint64_t version_ = 0;
 };
 
 } // namespace org::deepin::dim
@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Tracer.h"
+
+#include <QDebug>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace org::deepin::dim;
+
+std::atomic<bool> Tracer::enabled_{ false };
+
+namespace {
+
+struct Span
+{
+    const char *category;
+    const char *name;
+    uint64_t beginUs;
+    uint64_t durationUs;
+    uint32_t tid;
+};
+
+struct SpanBuffer
+{
+    std::mutex mutex;
+    std::vector<Span> spans;
+    // the slot the next span is written to
+    size_t next = 0;
+    bool wrapped = false;
+};
+
+SpanBuffer &spanBuffer()
+{
+    static SpanBuffer buffer;
+    return buffer;
+}
+
+uint32_t currentTid()
+{
+    static thread_local uint32_t tid = syscall(SYS_gettid);
+    return tid;
+}
+
+QString envTracePath;
+
+void dumpAtExit()
+{
+    Tracer::dump(envTracePath);
+}
+
+} // namespace
+
+void Tracer::startFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("DIM_TRACE");
+    if (path.isEmpty() || isEnabled()) {
+        return;
+    }
+
+    envTracePath = path;
+    start();
+    std::atexit(dumpAtExit);
+}
+
+void Tracer::start(size_t capacity)
+{
+    auto &buffer = spanBuffer();
+
+    {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.spans.assign(std::max<size_t>(capacity, 1), Span{});
+        buffer.next = 0;
+        buffer.wrapped = false;
+    }
+
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::addSpan(const char *category, const char *name, uint64_t beginUs, uint64_t endUs)
+{
+    auto &buffer = spanBuffer();
+    const uint32_t tid = currentTid();
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.spans.empty()) {
+        return;
+    }
+
+    buffer.spans[buffer.next] = Span{ category, name, beginUs, endUs - beginUs, tid };
+    if (++buffer.next == buffer.spans.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+bool Tracer::dump(const QString &path)
+{
+    auto &buffer = spanBuffer();
+
+    QByteArray json;
+    {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+
+        const size_t count = buffer.wrapped ? buffer.spans.size() : buffer.next;
+        const size_t first = buffer.wrapped ? buffer.next : 0;
+        const QByteArray pid = QByteArray::number(getpid());
+
+        json.reserve(count * 96 + 64);
+        json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for (size_t i = 0; i < count; i++) {
+            const auto &span = buffer.spans[(first + i) % buffer.spans.size()];
+            if (i) {
+                json.append(',');
+            }
+            json.append("{\"ph\":\"X\",\"cat\":\"")
+                .append(span.category)
+                .append("\",\"name\":\"")
+                .append(span.name)
+                .append("\",\"ts\":")
+                .append(QByteArray::number(span.beginUs))
+                .append(",\"dur\":")
+                .append(QByteArray::number(span.durationUs))
+                .append(",\"pid\":")
+                .append(pid)
+                .append(",\"tid\":")
+                .append(QByteArray::number(span.tid))
+                .append('}');
+        }
+        json.append("]}\n");
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qWarning() << "failed to write trace to" << path;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "common/common.h"
+
+#include <QString>
+
+#include <atomic>
+
+namespace org {
+namespace deepin {
+namespace dim {
+
+// Opt-in tracer of the input pipeline.
+//
+// Spans are kept in a ring buffer and dumped in the Chrome trace event format, which can be
+// opened in chrome://tracing or Perfetto. Tracing is started by setting DIM_TRACE to the path of
+// the output file, which is written when dim exits, or through the StartTrace/StopTrace D-Bus
+// methods. When tracing is off a span costs a relaxed atomic load.
+class Tracer
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static void startFromEnvironment();
+    static void start(size_t capacity = DEFAULT_CAPACITY);
+    static void stop();
+    // writes the spans in the buffer to path
+    static bool dump(const QString &path);
+
+    // category and name must be string literals, only the pointers are kept
+    static void addSpan(const char *category, const char *name, uint64_t beginUs, uint64_t endUs);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+        : category_(category)
+        , name_(name)
+        , beginUs_(Tracer::isEnabled() ? getMonotonicUs() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (beginUs_) {
+            Tracer::addSpan(category_, name_, beginUs_, getMonotonicUs());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *category_;
+    const char *name_;
+    const uint64_t beginUs_;
+};
+
+} // namespace dim
+} // namespace deepin
+} // namespace org
+
+#define DIM_TRACE_CONCAT_IMPL(a, b) a##b
+#define DIM_TRACE_CONCAT(a, b) DIM_TRACE_CONCAT_IMPL(a, b)
+
+// traces the enclosing scope as a span
+#define DIM_TRACE_SCOPE(category, name) \
+    ::org::deepin::dim::TraceScope DIM_TRACE_CONCAT(dimTraceScope, __LINE__)(category, name)
+
+#endif // !TRACER_H
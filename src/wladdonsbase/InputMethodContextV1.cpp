@@ -31,13 +31,20 @@ void InputMethodContextV1::sendSurroundingText(const char *text, uint32_t cursor
 
 void InputMethodContextV1::setCursorRectangle(int x, int y, int width, int height) { }
 
-void InputMethodContextV1::sendKey(uint32_t keycode, bool isRelease)
+uint32_t InputMethodContextV1::sendKey(uint32_t keycode, bool isRelease)
 {
     uint32_t ts = getTimestamp();
 
-    getKeyboardGrab()->sendKey(0,
+    // 0 stands for no serial
+    if (++keySerial_ == 0) {
+        keySerial_ = 1;
+    }
+
+    getKeyboardGrab()->sendKey(keySerial_,
                                ts,
                                keycode,
                                isRelease ? WL_KEYBOARD_KEY_STATE_RELEASED
                                          : WL_KEYBOARD_KEY_STATE_PRESSED);
+
+    return keySerial_;
 }
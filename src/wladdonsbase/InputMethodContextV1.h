@@ -21,7 +21,11 @@ public:
     void sendContentType(uint32_t hint, uint32_t purpose);
     void sendSurroundingText(const char *text, uint32_t cursor, uint32_t anchor);
     void setCursorRectangle(int x, int y, int width, int height);
-    void sendKey(uint32_t keycode, bool isRelease);
+    // returns the serial of the key, the input method forwards the key back with it
+    uint32_t sendKey(uint32_t keycode, bool isRelease);
+
+private:
+    uint32_t keySerial_ = 0;
 };
 
 WL_ADDONS_BASE_END_NAMESPACE
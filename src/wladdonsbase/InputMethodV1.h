@@ -34,7 +34,8 @@ public:
     std::function<void(uint32_t serial, const char *text)> inputMethodContextV1CommitCallback_;
     std::function<void(uint32_t serial, const char *text, const char *commit)>
         inputMethodContextV1PreeditCallback_;
-    std::function<void(uint32_t key, uint32_t state)> inputMethodContextV1ForwardKeyCallback_;
+    std::function<void(uint32_t serial, uint32_t key, uint32_t state)>
+        inputMethodContextV1ForwardKeyCallback_;
     Cb inputPanelV1CreateCallback_;
     Cb inputPanelV1DestoryCallback_;
 
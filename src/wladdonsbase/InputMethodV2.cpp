@@ -67,19 +67,29 @@ void InputMethodV2::setCursorRectangle(int x, int y, int width, int height)
     wlr_input_popup_surface_v2_send_text_input_rectangle(popup_, &rectangle);
 }
 
-void InputMethodV2::sendKey(uint32_t keycode, bool isRelease)
+uint32_t InputMethodV2::sendKey(uint32_t keycode, bool isRelease)
 {
     if (!input_method_->keyboard_grab) {
-        return;
+        return 0;
     }
 
+    // a key within the same millisecond as the last one gets the next one, 0 is skipped
     uint32_t ts = getTimestamp();
+    if (static_cast<int32_t>(ts - lastKeyTime_) <= 0) {
+        ts = lastKeyTime_ + 1;
+    }
+    if (ts == 0) {
+        ts = 1;
+    }
+    lastKeyTime_ = ts;
 
     wlr_input_method_keyboard_grab_v2_send_key(input_method_->keyboard_grab,
                                                ts,
                                                keycode,
                                                isRelease ? WL_KEYBOARD_KEY_STATE_RELEASED
                                                          : WL_KEYBOARD_KEY_STATE_PRESSED);
+
+    return ts;
 }
 
 void InputMethodV2::commitNotify(void *data)
@@ -48,7 +48,10 @@ public:
     void sendSurroundingText(const char *text, uint32_t cursor, uint32_t anchor);
     void sendDone();
     void setCursorRectangle(int x, int y, int width, int height);
-    void sendKey(uint32_t keycode, bool isRelease);
+    // Returns the time the key was sent with, 0 if there's no keyboard grab. The times of the keys
+    // are unique, the input method forwards a key back through the virtual keyboard with its
+    // time, which names the key.
+    uint32_t sendKey(uint32_t keycode, bool isRelease);
 
     wlr_input_method_v2_preedit_string &preeditString() { return input_method_->current.preedit; }
 
@@ -85,6 +88,8 @@ private:
 
     Listener<&InputMethodV2::keyboardGrabDestroyNotify> keyboard_grab_destroy_;
 
+    uint32_t lastKeyTime_ = 0;
+
     std::function<void()> commitCallback_;
     std::function<void()> popupCreateCallback_;
     std::function<void()> popupDestroyCallback_;
@@ -156,7 +156,7 @@ void ZwpInputMethodContextV1::zwp_input_method_context_v1_key(
     Resource *resource, uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
     if (inputMethodV1_->inputMethodContextV1ForwardKeyCallback_) {
-        inputMethodV1_->inputMethodContextV1ForwardKeyCallback_(key, state);
+        inputMethodV1_->inputMethodContextV1ForwardKeyCallback_(serial, key, state);
     }
 }
 